@@ -0,0 +1,174 @@
+#pragma once
+
+#include "viewer.hpp"
+
+#include <vector>
+
+
+namespace Slam_viewer {
+namespace Evaluation {
+
+//  +--------------------------------------------------------
+//  |       Trajectory error metrics
+//  +--------------------------------------------------------
+//  |
+//  | Compares an estimated trajectory with its ground truth, pose i of
+//  | the estimate matching pose i of the ground truth:
+//  |  - the absolute trajectory error (ATE) is the distance between the
+//  |    matching positions once the estimate is aligned on the ground
+//  |    truth by the closed form of Umeyama (rotation, translation and
+//  |    optionally scale minimizing the squared distances)
+//  |  - the relative pose error (RPE) compares the motions between the
+//  |    poses i and i + delta of both trajectories, it measures the drift
+//  |    whatever the alignment
+//  | The sums are made in double precision, the per pose and per pair
+//  | errors are computed in parallel.
+//  | PS: These functions throw std::runtime_error in case of failure
+//  |
+//  +--------------------------------------------------------
+
+struct Error_statistics {
+    size_t count {0};
+    double rmse {0};
+    double mean {0};
+    double median {0};
+    double max {0};
+};
+
+//! translation and rotation errors of the motions between the poses i and i + delta
+struct Relative_error {
+    size_t delta {1};
+    Error_statistics translation;
+    Error_statistics rotation_degrees;
+};
+
+//! similarity transform moving the estimated positions onto the ground truth ones with the least squared
+//! distances (Umeyama 1991): ground_truth[i].p ~ scale * R * estimate[i].p + translation.
+//! The scale is 1 if with_scale is false. The returned transform is a left one, see Marithmetic::transform_poses
+inline Pose_transform align(const std::vector<Camera_pose>& estimate,
+                            const std::vector<Camera_pose>& ground_truth,
+                            const bool with_scale);
+
+//! distance between each aligned estimated position and its ground truth position
+inline std::vector<double> absolute_errors(const std::vector<Camera_pose>& estimate,
+                                           const std::vector<Camera_pose>& ground_truth,
+                                           const Pose_transform& alignment);
+
+//! translation error (distance) and rotation error (angle in degrees) of each aligned estimated pose with its
+//! ground truth pose, in single precision: they are meant for coloring the poses, see Viewer::set_cameras_values.
+//! The estimate is aligned by blocks with Marithmetic::transform_poses
+inline void pose_errors(const std::vector<Camera_pose>& estimate,
+                        const std::vector<Camera_pose>& ground_truth,
+                        const Pose_transform& alignment,
+                        std::vector<float>& translation_errors,
+                        std::vector<float>& rotation_errors);
+
+//! scale of the Sim(3) alignment (Umeyama) of the estimate on the ground truth over the window of window poses
+//! centered on each pose, the first and last poses take the first and last windows: a scale changing along the
+//! trajectory shows where a monocular estimate drifts in scale. The sums of the positions, of their products
+//! and of their squared norms are updated by one pose in and one pose out at each step (relative to the first
+//! pose of each fixed chunk of windows, which keeps the sums small). NaN if all positions of a window are the same
+inline std::vector<double> window_scales(const std::vector<Camera_pose>& estimate,
+                                         const std::vector<Camera_pose>& ground_truth,
+                                         const size_t window);
+
+//! errors of the motions between the poses i and i + delta (one per pair), the estimated translations are
+//! multiplied by scale (the scale of the alignment) and the rotation errors are in degrees
+inline void relative_errors(const std::vector<Camera_pose>& estimate,
+                            const std::vector<Camera_pose>& ground_truth,
+                            const size_t delta, const double scale,
+                            std::vector<double>& translation_errors,
+                            std::vector<double>& rotation_errors);
+
+//! same as above, only the statistics of the errors are returned
+inline Relative_error relative_error(const std::vector<Camera_pose>& estimate,
+                                     const std::vector<Camera_pose>& ground_truth,
+                                     const size_t delta, const double scale);
+
+//! root mean square, mean, median and max of the errors, all 0 if there is none
+inline Error_statistics statistics(const std::vector<double>& errors);
+
+//  +--------------------------------------------------------
+//  |       KITTI odometry drift
+//  +--------------------------------------------------------
+//  |
+//  | Errors of the segments of the KITTI odometry benchmark: from every
+//  | step-th start pose, the segment of each length ends at the first
+//  | pose whose ground truth path distance from the start pose exceeds
+//  | the length, and the motion of the estimate along the segment is
+//  | compared with the true one as in the devkit (evaluate_odometry.cpp).
+//  | The path distances are a prefix sum, the end poses of each chunk of
+//  | start poses are found by a binary search then by pointers moving
+//  | forward only. The start poses are evaluated in parallel
+//  |
+//  +--------------------------------------------------------
+
+//! mean errors of the segments of one length, divided by the length
+struct Segment_drift {
+    //! segment length, 0 for the mean of all the segments
+    double length {0};
+    size_t count {0};
+    //! translation error per meter (x 100 for the KITTI percentage)
+    double translation {0};
+    //! rotation error in degrees per meter
+    double rotation_degrees {0};
+};
+
+struct Drift {
+    //! one entry per segment length, even without segments
+    std::vector<Segment_drift> segments;
+    //! mean of all the segments of all the lengths
+    Segment_drift total;
+};
+
+//! KITTI drift of the estimate along the segments of the given lengths (in the unit of the positions) starting
+//! at every step-th pose. The estimated translations are multiplied by scale (the scale of the alignment,
+//! 1 in the devkit). The lengths of the benchmark are 100, 200... 800 m and the step is 10 poses
+inline Drift segment_drift(const std::vector<Camera_pose>& estimate,
+                           const std::vector<Camera_pose>& ground_truth,
+                           const std::vector<double>& lengths,
+                           const size_t step,
+                           const double scale);
+
+//  +--------------------------------------------------------
+//  |       Timestamp association
+//  +--------------------------------------------------------
+//  |
+//  | Matches the poses of two trajectories logged at different times.
+//  | Both timestamp lists are sorted, so a single merge walking them
+//  | with two indices finds all matches in O(n + m)
+//  |
+//  +--------------------------------------------------------
+
+//! estimated pose matched with the ground truth pose ground_truth, or with the pose at the fraction
+//! weight between the ground truth poses ground_truth and ground_truth + 1 if it is interpolated
+struct Association {
+    size_t estimate;
+    size_t ground_truth;
+    float weight;
+};
+
+//! match the estimated poses with the ground truth poses by timestamp, the timestamps should be non decreasing.
+//! Without interpolation, each estimated pose is matched with the closest ground truth pose in time if they are
+//! at most max_difference apart, and each ground truth pose is used once (by the closest estimated pose).
+//! With interpolation, an estimated pose with the timestamp of a ground truth pose is matched with it, any
+//! other estimated pose is matched with the ground truth interpolated at its timestamp if the ground truth
+//! poses before and after it are at most max_difference away.
+//! The associations are sorted by estimated pose, then by ground truth pose
+inline std::vector<Association> associate(const std::vector<double>& estimate_timestamps,
+                                          const std::vector<double>& ground_truth_timestamps,
+                                          const double max_difference,
+                                          const bool interpolate);
+
+//! the matched poses in the order of the associations, the interpolated ground truth poses are
+//! computed by Marithmetic::interpolate_poses
+inline void matched_poses(const std::vector<Camera_pose>& estimate,
+                          const std::vector<Camera_pose>& ground_truth,
+                          const std::vector<Association>& associations,
+                          std::vector<Camera_pose>& matched_estimate,
+                          std::vector<Camera_pose>& matched_ground_truth);
+
+}
+}
+
+#include "evaluation_impl.hpp"
@@ -0,0 +1,559 @@
+#pragma once
+#include "evaluation.hpp"
+#include "marithmetic.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+namespace Slam_viewer {
+namespace Evaluation {
+namespace detail {
+
+// quaternion in double precision, the rotations follow the conventions of Marithmetic::multiply
+struct Quaternion_d {
+    double x, y, z, w;
+};
+
+inline Quaternion_d to_double(const Quaternion& q)
+{
+    const double norm = std::sqrt(static_cast<double>(q.x) * q.x + static_cast<double>(q.y) * q.y
+                                  + static_cast<double>(q.z) * q.z + static_cast<double>(q.w) * q.w);
+    return {q.x / norm, q.y / norm, q.z / norm, q.w / norm};
+}
+
+inline Quaternion_d multiply(const Quaternion_d& a, const Quaternion_d& b)
+{
+    return {a.x * b.w + a.w * b.x + a.y * b.z - a.z * b.y,
+            a.y * b.w + a.w * b.y + a.z * b.x - a.x * b.z,
+            a.z * b.w + a.w * b.z + a.x * b.y - a.y * b.x,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+inline Quaternion_d conjugate(const Quaternion_d& q)
+{
+    return {-q.x, -q.y, -q.z, q.w};
+}
+
+// v rotated by the unit quaternion q
+inline linalg::vec<double, 3> rotate(const Quaternion_d& q, const linalg::vec<double, 3>& v)
+{
+    const linalg::vec<double, 3> u {q.x, q.y, q.z};
+    const linalg::vec<double, 3> t = linalg::cross(u, v) * 2.0;
+    return v + t * q.w + linalg::cross(u, t);
+}
+
+inline linalg::vec<double, 3> position(const Camera_pose& pose)
+{
+    return {pose.p.x, pose.p.y, pose.p.z};
+}
+
+// the pairs are summed by fixed chunks, so the sums do not depend on the number of threads
+const size_t chunk_size = 1 << 16;
+
+inline size_t num_chunks(const size_t size)
+{
+    return (size + chunk_size - 1) / chunk_size;
+}
+
+}
+}
+}
+
+Slam_viewer::Pose_transform Slam_viewer::Evaluation::align(const std::vector<Camera_pose>& estimate,
+                                                           const std::vector<Camera_pose>& ground_truth,
+                                                           const bool with_scale)
+{
+    if(estimate.size() != ground_truth.size()){
+        throw std::runtime_error("In align: the estimate has " + std::to_string(estimate.size())
+                                 + " poses and the ground truth " + std::to_string(ground_truth.size()) + ".");
+    }
+    const size_t size = estimate.size();
+    if(size == 0){
+        throw std::runtime_error("In align: the trajectories are empty.");
+    }
+
+    // means, then the cross covariance and the variance of the centered positions
+    const size_t num_chunks = detail::num_chunks(size);
+    std::vector<linalg::vec<double, 3>> estimate_sums(num_chunks), truth_sums(num_chunks);
+    Parallel::parallel_tasks(num_chunks, [&](size_t chunk){
+        linalg::vec<double, 3> e {0, 0, 0}, g {0, 0, 0};
+        for(size_t i = chunk * detail::chunk_size; i < std::min(size, (chunk + 1) * detail::chunk_size); i++){
+            e += detail::position(estimate[i]);
+            g += detail::position(ground_truth[i]);
+        }
+        estimate_sums[chunk] = e;
+        truth_sums[chunk] = g;
+    });
+    linalg::vec<double, 3> estimate_mean {0, 0, 0}, truth_mean {0, 0, 0};
+    for(size_t chunk = 0; chunk < num_chunks; chunk++){
+        estimate_mean += estimate_sums[chunk];
+        truth_mean += truth_sums[chunk];
+    }
+    estimate_mean /= static_cast<double>(size);
+    truth_mean /= static_cast<double>(size);
+
+    std::vector<linalg::mat<double, 3, 3>> covariances(num_chunks);
+    std::vector<double> variances(num_chunks);
+    Parallel::parallel_tasks(num_chunks, [&](size_t chunk){
+        linalg::mat<double, 3, 3> covariance {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+        double variance = 0;
+        for(size_t i = chunk * detail::chunk_size; i < std::min(size, (chunk + 1) * detail::chunk_size); i++){
+            const linalg::vec<double, 3> e = detail::position(estimate[i]) - estimate_mean;
+            const linalg::vec<double, 3> g = detail::position(ground_truth[i]) - truth_mean;
+            covariance += linalg::outerprod(g, e);
+            variance += linalg::length2(e);
+        }
+        covariances[chunk] = covariance;
+        variances[chunk] = variance;
+    });
+    linalg::mat<double, 3, 3> covariance {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    double variance = 0;
+    for(size_t chunk = 0; chunk < num_chunks; chunk++){
+        covariance += covariances[chunk];
+        variance += variances[chunk];
+    }
+
+    // with the signed decomposition covariance = U S V^T (U and V rotations), the best rotation is
+    // U V^T and the best scale is trace(S) / variance
+    linalg::mat<double, 3, 3> u, v;
+    linalg::vec<double, 3> s;
+    Marithmetic::svd3(covariance, u, s, v);
+    const linalg::mat<double, 3, 3> rotation = linalg::mul(u, linalg::transpose(v));
+    const double scale = with_scale && variance > 0 ? (s[0] + s[1] + s[2]) / variance : 1;
+    const linalg::vec<double, 3> translation = truth_mean - linalg::mul(rotation, estimate_mean) * scale;
+
+    Pose_transform alignment;
+    const linalg::vec<double, 4> q = linalg::rotation_quat(rotation);
+    alignment.rotation = {static_cast<float>(q.x), static_cast<float>(q.y),
+                          static_cast<float>(q.z), static_cast<float>(q.w)};
+    alignment.translation = {static_cast<float>(translation.x), static_cast<float>(translation.y),
+                             static_cast<float>(translation.z)};
+    alignment.scale = static_cast<float>(scale);
+    alignment.left = true;
+    return alignment;
+}
+
+std::vector<double> Slam_viewer::Evaluation::absolute_errors(const std::vector<Camera_pose>& estimate,
+                                                             const std::vector<Camera_pose>& ground_truth,
+                                                             const Pose_transform& alignment)
+{
+    if(estimate.size() != ground_truth.size()){
+        throw std::runtime_error("In absolute_errors: the estimate has " + std::to_string(estimate.size())
+                                 + " poses and the ground truth " + std::to_string(ground_truth.size()) + ".");
+    }
+    const detail::Quaternion_d rotation = detail::to_double(alignment.rotation);
+    const linalg::vec<double, 3> translation {alignment.translation.x, alignment.translation.y,
+                                              alignment.translation.z};
+    const double scale = alignment.scale;
+    std::vector<double> errors(estimate.size());
+    Parallel::parallel_for(0, estimate.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const linalg::vec<double, 3> aligned = detail::rotate(rotation, detail::position(estimate[i])) * scale
+                    + translation;
+            errors[i] = linalg::length(aligned - detail::position(ground_truth[i]));
+        }
+    });
+    return errors;
+}
+
+void Slam_viewer::Evaluation::pose_errors(const std::vector<Camera_pose>& estimate,
+                                          const std::vector<Camera_pose>& ground_truth,
+                                          const Pose_transform& alignment,
+                                          std::vector<float>& translation_errors,
+                                          std::vector<float>& rotation_errors)
+{
+    if(estimate.size() != ground_truth.size()){
+        throw std::runtime_error("In pose_errors: the estimate has " + std::to_string(estimate.size())
+                                 + " poses and the ground truth " + std::to_string(ground_truth.size()) + ".");
+    }
+    translation_errors.resize(estimate.size());
+    rotation_errors.resize(estimate.size());
+
+    // the error rotation conj(q_truth) q_aligned has the angle 2 atan2(|xyz|, |w|), which stays accurate
+    // for small errors unlike acos(|w|)
+    const float degrees = 180 / 3.14159265358979323846f;
+    Parallel::parallel_for(0, estimate.size(), [&](size_t begin, size_t end){
+        const size_t block_size = 256;
+        Camera_pose block[block_size];
+        for(size_t first = begin; first < end; first += block_size){
+            const size_t count = std::min(block_size, end - first);
+            Marithmetic::transform_poses(estimate.data() + first, block, count, alignment);
+            const Camera_pose* truth = ground_truth.data() + first;
+            for(size_t k = 0; k < count; k++){
+                const Quaternion& a = block[k].q;
+                const Quaternion& g = truth[k].q;
+                const float dx = block[k].p.x - truth[k].p.x;
+                const float dy = block[k].p.y - truth[k].p.y;
+                const float dz = block[k].p.z - truth[k].p.z;
+                const float x = g.w * a.x - g.x * a.w - g.y * a.z + g.z * a.y;
+                const float y = g.w * a.y - g.y * a.w - g.z * a.x + g.x * a.z;
+                const float z = g.w * a.z - g.z * a.w - g.x * a.y + g.y * a.x;
+                const float w = g.w * a.w + g.x * a.x + g.y * a.y + g.z * a.z;
+                translation_errors[first + k] = std::sqrt(dx * dx + dy * dy + dz * dz);
+                rotation_errors[first + k] = 2 * std::atan2(std::sqrt(x * x + y * y + z * z), std::abs(w)) * degrees;
+            }
+        }
+    });
+}
+
+std::vector<double> Slam_viewer::Evaluation::window_scales(const std::vector<Camera_pose>& estimate,
+                                                          const std::vector<Camera_pose>& ground_truth,
+                                                          const size_t window)
+{
+    if(estimate.size() != ground_truth.size()){
+        throw std::runtime_error("In window_scales: the estimate has " + std::to_string(estimate.size())
+                                 + " poses and the ground truth " + std::to_string(ground_truth.size()) + ".");
+    }
+    if(window < 2 || window > estimate.size()){
+        throw std::runtime_error("In window_scales: the window of " + std::to_string(window)
+                                 + " poses should have at least 2 poses and at most "
+                                 + std::to_string(estimate.size()) + ".");
+    }
+    const size_t size = estimate.size();
+    const size_t num_windows = size - window + 1;
+    std::vector<double> window_scale(num_windows);
+    const double n = static_cast<double>(window);
+    Parallel::parallel_tasks(detail::num_chunks(num_windows), [&](size_t chunk){
+        const size_t first = chunk * detail::chunk_size;
+        const size_t last = std::min(num_windows, (chunk + 1) * detail::chunk_size);
+        const linalg::vec<double, 3> estimate_reference = detail::position(estimate[first]);
+        const linalg::vec<double, 3> truth_reference = detail::position(ground_truth[first]);
+        linalg::vec<double, 3> estimate_sum {0, 0, 0}, truth_sum {0, 0, 0};
+        linalg::mat<double, 3, 3> product_sum {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+        double square_sum = 0;
+        auto update = [&](const size_t i, const double sign){
+            const linalg::vec<double, 3> e = detail::position(estimate[i]) - estimate_reference;
+            const linalg::vec<double, 3> g = detail::position(ground_truth[i]) - truth_reference;
+            estimate_sum += e * sign;
+            truth_sum += g * sign;
+            product_sum += linalg::outerprod(g, e) * sign;
+            square_sum += linalg::length2(e) * sign;
+        };
+        for(size_t i = first; i < first + window; i++)
+            update(i, 1);
+
+        for(size_t k = first; k < last; k++){
+            if(k > first){
+                update(k - 1, -1);
+                update(k + window - 1, 1);
+            }
+            // centered cross covariance and variance of the window, as in align
+            const linalg::vec<double, 3> estimate_mean = estimate_sum / n;
+            const linalg::vec<double, 3> truth_mean = truth_sum / n;
+            const linalg::mat<double, 3, 3> covariance = product_sum / n - linalg::outerprod(truth_mean, estimate_mean);
+            const double variance = square_sum / n - linalg::length2(estimate_mean);
+            linalg::mat<double, 3, 3> u, v;
+            linalg::vec<double, 3> s;
+            Marithmetic::svd3(covariance, u, s, v);
+            // the rounding of the running sums is relative to the mean squared norm
+            window_scale[k] = variance > 1e-12 * square_sum / n ? (s[0] + s[1] + s[2]) / variance
+                                                                 : std::numeric_limits<double>::quiet_NaN();
+        }
+    });
+
+    std::vector<double> scales(size);
+    for(size_t i = 0; i < size; i++)
+        scales[i] = window_scale[std::min(num_windows - 1, i > window / 2 ? i - window / 2 : 0)];
+    return scales;
+}
+
+void Slam_viewer::Evaluation::relative_errors(const std::vector<Camera_pose>& estimate,
+                                              const std::vector<Camera_pose>& ground_truth,
+                                              const size_t delta, const double scale,
+                                              std::vector<double>& translation_errors,
+                                              std::vector<double>& rotation_errors)
+{
+    if(estimate.size() != ground_truth.size()){
+        throw std::runtime_error("In relative_errors: the estimate has " + std::to_string(estimate.size())
+                                 + " poses and the ground truth " + std::to_string(ground_truth.size()) + ".");
+    }
+    if(delta == 0){
+        throw std::runtime_error("In relative_errors: the delta should be positive.");
+    }
+    const size_t num_pairs = estimate.size() > delta ? estimate.size() - delta : 0;
+    translation_errors.resize(num_pairs);
+    rotation_errors.resize(num_pairs);
+
+    // motion from pose i to pose j in the frame of pose i: conj(q_i) q_j and conj(q_i) (p_j - p_i)
+    const double degrees = 180 / 3.14159265358979323846;
+    Parallel::parallel_for(0, num_pairs, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const size_t j = i + delta;
+            const detail::Quaternion_d estimate_i = detail::conjugate(detail::to_double(estimate[i].q));
+            const detail::Quaternion_d truth_i = detail::conjugate(detail::to_double(ground_truth[i].q));
+            const detail::Quaternion_d estimate_motion = detail::multiply(estimate_i, detail::to_double(estimate[j].q));
+            const detail::Quaternion_d truth_motion = detail::multiply(truth_i, detail::to_double(ground_truth[j].q));
+            const linalg::vec<double, 3> estimate_step = detail::rotate(
+                        estimate_i, detail::position(estimate[j]) - detail::position(estimate[i])) * scale;
+            const linalg::vec<double, 3> truth_step = detail::rotate(
+                        truth_i, detail::position(ground_truth[j]) - detail::position(ground_truth[i]));
+
+            // the error motion is the inverse of the true motion followed by the estimated one
+            const detail::Quaternion_d error = detail::multiply(detail::conjugate(truth_motion), estimate_motion);
+            const double sine = std::sqrt(error.x * error.x + error.y * error.y + error.z * error.z);
+            translation_errors[i] = linalg::length(estimate_step - truth_step);
+            rotation_errors[i] = 2 * std::atan2(sine, std::abs(error.w)) * degrees;
+        }
+    });
+}
+
+Slam_viewer::Evaluation::Relative_error Slam_viewer::Evaluation::relative_error(
+        const std::vector<Camera_pose>& estimate,
+        const std::vector<Camera_pose>& ground_truth,
+        const size_t delta, const double scale)
+{
+    std::vector<double> translation_errors, rotation_errors;
+    relative_errors(estimate, ground_truth, delta, scale, translation_errors, rotation_errors);
+    Relative_error error;
+    error.delta = delta;
+    error.translation = statistics(translation_errors);
+    error.rotation_degrees = statistics(rotation_errors);
+    return error;
+}
+
+Slam_viewer::Evaluation::Error_statistics Slam_viewer::Evaluation::statistics(const std::vector<double>& errors)
+{
+    Error_statistics stats;
+    stats.count = errors.size();
+    if(errors.empty())
+        return stats;
+
+    const size_t num_chunks = detail::num_chunks(errors.size());
+    std::vector<double> sums(num_chunks), squares(num_chunks), maxima(num_chunks);
+    Parallel::parallel_tasks(num_chunks, [&](size_t chunk){
+        double sum = 0, square = 0, max = 0;
+        for(size_t i = chunk * detail::chunk_size; i < std::min(errors.size(), (chunk + 1) * detail::chunk_size); i++){
+            sum += errors[i];
+            square += errors[i] * errors[i];
+            max = std::max(max, errors[i]);
+        }
+        sums[chunk] = sum;
+        squares[chunk] = square;
+        maxima[chunk] = max;
+    });
+    double sum = 0, square = 0;
+    for(size_t chunk = 0; chunk < num_chunks; chunk++){
+        sum += sums[chunk];
+        square += squares[chunk];
+        stats.max = std::max(stats.max, maxima[chunk]);
+    }
+    const double n = static_cast<double>(errors.size());
+    stats.mean = sum / n;
+    stats.rmse = std::sqrt(square / n);
+
+    // the median of an even count is the mean of the two middle errors
+    std::vector<double> sorted = errors;
+    const size_t middle = sorted.size() / 2;
+    std::nth_element(sorted.begin(), sorted.begin() + middle, sorted.end());
+    stats.median = sorted[middle];
+    if(sorted.size() % 2 == 0)
+        stats.median = (stats.median + *std::max_element(sorted.begin(), sorted.begin() + middle)) / 2;
+    return stats;
+}
+
+Slam_viewer::Evaluation::Drift Slam_viewer::Evaluation::segment_drift(const std::vector<Camera_pose>& estimate,
+                                                                     const std::vector<Camera_pose>& ground_truth,
+                                                                     const std::vector<double>& lengths,
+                                                                     const size_t step,
+                                                                     const double scale)
+{
+    if(estimate.size() != ground_truth.size()){
+        throw std::runtime_error("In segment_drift: the estimate has " + std::to_string(estimate.size())
+                                 + " poses and the ground truth " + std::to_string(ground_truth.size()) + ".");
+    }
+    if(step == 0){
+        throw std::runtime_error("In segment_drift: the step should be positive.");
+    }
+    for(const double length: lengths){
+        if(!(length > 0)){
+            throw std::runtime_error("In segment_drift: the segment lengths should be positive.");
+        }
+    }
+    const size_t size = ground_truth.size();
+    const size_t num_lengths = lengths.size();
+    const std::vector<double> distances = Marithmetic::arc_lengths(ground_truth);
+
+    // sums of the errors divided by the lengths, by length and by fixed chunk of start poses
+    struct Sums {
+        size_t count;
+        double translation;
+        double rotation;
+    };
+    const size_t num_starts = (size + step - 1) / step;
+    const size_t num_chunks = detail::num_chunks(num_starts);
+    std::vector<Sums> sums(num_chunks * num_lengths, Sums {0, 0, 0});
+    const double degrees = 180 / 3.14159265358979323846;
+    Parallel::parallel_tasks(num_chunks, [&](size_t chunk){
+        const size_t first_start = chunk * detail::chunk_size;
+        const size_t last_start = std::min(num_starts, (chunk + 1) * detail::chunk_size);
+        // the end pose of each length only moves forward with the start pose
+        std::vector<size_t> ends(num_lengths);
+        for(size_t l = 0; l < num_lengths; l++){
+            const size_t first = first_start * step;
+            ends[l] = std::upper_bound(distances.begin() + first, distances.end(), distances[first] + lengths[l])
+                    - distances.begin();
+        }
+        for(size_t start = first_start; start < last_start; start++){
+            const size_t i = start * step;
+            const detail::Quaternion_d estimate_i = detail::conjugate(detail::to_double(estimate[i].q));
+            const detail::Quaternion_d truth_i = detail::conjugate(detail::to_double(ground_truth[i].q));
+            for(size_t l = 0; l < num_lengths; l++){
+                size_t& j = ends[l];
+                while(j < size && distances[j] <= distances[i] + lengths[l])
+                    j++;
+                if(j == size)
+                    continue;
+
+                // as in the devkit: error = inverse(estimated motion) * true motion, its translation has the
+                // length of the difference of the translations of the motions
+                const detail::Quaternion_d estimate_motion = detail::multiply(estimate_i,
+                                                                              detail::to_double(estimate[j].q));
+                const detail::Quaternion_d truth_motion = detail::multiply(truth_i,
+                                                                           detail::to_double(ground_truth[j].q));
+                const linalg::vec<double, 3> estimate_step = detail::rotate(
+                            estimate_i, detail::position(estimate[j]) - detail::position(estimate[i])) * scale;
+                const linalg::vec<double, 3> truth_step = detail::rotate(
+                            truth_i, detail::position(ground_truth[j]) - detail::position(ground_truth[i]));
+                const detail::Quaternion_d error = detail::multiply(detail::conjugate(estimate_motion), truth_motion);
+                const double sine = std::sqrt(error.x * error.x + error.y * error.y + error.z * error.z);
+
+                Sums& sum = sums[chunk * num_lengths + l];
+                sum.count++;
+                sum.translation += linalg::length(truth_step - estimate_step) / lengths[l];
+                sum.rotation += 2 * std::atan2(sine, std::abs(error.w)) * degrees / lengths[l];
+            }
+        }
+    });
+
+    Drift drift;
+    drift.segments.resize(num_lengths);
+    for(size_t l = 0; l < num_lengths; l++){
+        Segment_drift& segment = drift.segments[l];
+        segment.length = lengths[l];
+        for(size_t chunk = 0; chunk < num_chunks; chunk++){
+            const Sums& sum = sums[chunk * num_lengths + l];
+            segment.count += sum.count;
+            segment.translation += sum.translation;
+            segment.rotation_degrees += sum.rotation;
+        }
+        drift.total.count += segment.count;
+        drift.total.translation += segment.translation;
+        drift.total.rotation_degrees += segment.rotation_degrees;
+        if(segment.count > 0){
+            segment.translation /= segment.count;
+            segment.rotation_degrees /= segment.count;
+        }
+    }
+    if(drift.total.count > 0){
+        drift.total.translation /= drift.total.count;
+        drift.total.rotation_degrees /= drift.total.count;
+    }
+    return drift;
+}
+
+std::vector<Slam_viewer::Evaluation::Association> Slam_viewer::Evaluation::associate(
+        const std::vector<double>& estimate_timestamps,
+        const std::vector<double>& ground_truth_timestamps,
+        const double max_difference,
+        const bool interpolate)
+{
+    const std::vector<double>& e = estimate_timestamps;
+    const std::vector<double>& g = ground_truth_timestamps;
+    for(size_t i = 1; i < e.size(); i++){
+        if(!(e[i] >= e[i - 1])){
+            throw std::runtime_error("In associate: the estimated timestamps decrease at pose " + std::to_string(i) + ".");
+        }
+    }
+    for(size_t j = 1; j < g.size(); j++){
+        if(!(g[j] >= g[j - 1])){
+            throw std::runtime_error("In associate: the ground truth timestamps decrease at pose "
+                                     + std::to_string(j) + ".");
+        }
+    }
+
+    std::vector<Association> associations;
+    if(g.empty())
+        return associations;
+    size_t j = 0;
+    for(size_t i = 0; i < e.size(); i++){
+        if(interpolate){
+            // g[j] is the last ground truth timestamp not after e[i]
+            while(j + 1 < g.size() && g[j + 1] <= e[i])
+                j++;
+            if(g[j] > e[i] || e[i] - g[j] > max_difference)
+                continue;
+            // an exact match does not use the next ground truth pose
+            const double gap = j + 1 < g.size() ? g[j + 1] - g[j] : 0;
+            const float weight = static_cast<float>(gap > 0 ? (e[i] - g[j]) / gap : 0);
+            if(g[j] == e[i] || (gap > 0 && weight == 0)){
+                associations.push_back({i, j, 0});
+                continue;
+            }
+            if(j + 1 == g.size() || g[j + 1] - e[i] > max_difference)
+                continue;
+            associations.push_back({i, j, weight});
+        } else {
+            // g[j] becomes the closest ground truth timestamp to e[i]
+            while(j + 1 < g.size() && std::abs(g[j + 1] - e[i]) <= std::abs(g[j] - e[i]))
+                j++;
+            if(std::abs(g[j] - e[i]) > max_difference)
+                continue;
+            // a ground truth pose already matched goes to the closest of the two estimated poses
+            if(!associations.empty() && associations.back().ground_truth == j){
+                if(std::abs(g[j] - e[associations.back().estimate]) <= std::abs(g[j] - e[i]))
+                    continue;
+                associations.pop_back();
+            }
+            associations.push_back({i, j, 0});
+        }
+    }
+    return associations;
+}
+
+void Slam_viewer::Evaluation::matched_poses(const std::vector<Camera_pose>& estimate,
+                                            const std::vector<Camera_pose>& ground_truth,
+                                            const std::vector<Association>& associations,
+                                            std::vector<Camera_pose>& matched_estimate,
+                                            std::vector<Camera_pose>& matched_ground_truth)
+{
+    const size_t size = associations.size();
+    for(const Association& association: associations){
+        if(association.estimate >= estimate.size() || association.ground_truth >= ground_truth.size()
+                || (association.weight > 0 && association.ground_truth + 1 >= ground_truth.size())){
+            throw std::runtime_error("In matched_poses: an association refers to a missing pose.");
+        }
+    }
+    matched_estimate.resize(size);
+    matched_ground_truth.resize(size);
+    Parallel::parallel_for(0, size, [&](size_t begin, size_t end){
+        // the ground truth poses are interpolated by blocks, a pose that is not interpolated is copied
+        const size_t block_size = 256;
+        size_t segments[block_size];
+        float weights[block_size];
+        for(size_t block = begin; block < end; block += block_size){
+            const size_t count = std::min(block_size, end - block);
+            size_t num_interpolated = 0;
+            for(size_t k = 0; k < count; k++){
+                const Association& association = associations[block + k];
+                matched_estimate[block + k] = estimate[association.estimate];
+                matched_ground_truth[block + k] = ground_truth[association.ground_truth];
+                if(association.weight > 0){
+                    segments[num_interpolated] = association.ground_truth;
+                    weights[num_interpolated++] = association.weight;
+                }
+            }
+            if(num_interpolated == 0)
+                continue;
+            Camera_pose interpolated[block_size];
+            Marithmetic::interpolate_poses(ground_truth.data(), segments, weights, interpolated, num_interpolated);
+            for(size_t k = 0, n = 0; k < count; k++)
+                if(associations[block + k].weight > 0)
+                    matched_ground_truth[block + k] = interpolated[n++];
+        }
+    });
+}
@@ -36,6 +36,92 @@ inline Quaternion to_quaternion(const linalg::mat<float,4, 4> mat);
 
 inline Quaternion normalize(const Quaternion q);
 
+//  +--------------------------------------------------------
+//  |       Batch quaternion kernels
+//  +--------------------------------------------------------
+//  |
+//  | Array versions of the functions above working on count contiguous
+//  | elements, in and out may be the same array. Blocks of 4 quaternions
+//  | are transposed to structure of arrays and processed in SSE lanes
+//  | (define SLAM_VIEWER_NO_SIMD to use the scalar code only), the results
+//  | are identical to the scalar functions
+//  |
+//  +--------------------------------------------------------
+
+//! out[i] = normalize(in[i])
+inline void normalize(const Quaternion* in, Quaternion* out, const size_t count);
+
+//! out[i] = multiply(in[i], q), e.g. to apply the same correction to all poses
+inline void multiply(const Quaternion* in, const Quaternion& q, Quaternion* out, const size_t count);
+
+//! out[i] = to_rot_matrix3(in[i])
+inline void to_rot_matrix3(const Quaternion* in, linalg::mat<float, 3, 3>* out, const size_t count);
+
+//! out[i] = transform applied to in[i], positions are rotated by the quaternions as in to_pose_matrix4
+inline void transform_poses(const Camera_pose* in, Camera_pose* out, const size_t count,
+                            const Pose_transform& transform);
+
+//  +--------------------------------------------------------
+//  |       Batch symmetric eigen decompositions
+//  +--------------------------------------------------------
+//  |
+//  | Cyclic Jacobi rotations on 4 matrices at once in SSE lanes with a
+//  | fixed number of sweeps, so there is no branch per matrix: 5 sweeps
+//  | bring the off-diagonal terms of a 3x3 float matrix to rounding noise.
+//  | The results are identical to the scalar code used for the tail
+//  |
+//  +--------------------------------------------------------
+
+//! eigen decomposition of each covariance: in[i] = V diag(eigenvalues[i]) V^T with V = eigenvectors[i]
+//! (eigenvector k in column k), the eigenvalues are not sorted
+inline void eigen_symmetric3(const Covariance* in, linalg::vec<float, 3>* eigenvalues,
+                             linalg::mat<float, 3, 3>* eigenvectors, const size_t count);
+
+//! signed singular value decomposition a = u diag(s) v^T where u and v are rotations, s[0] >= s[1] >= |s[2]|
+//! and s[2] is negative if det(a) is. Computed in double from the eigen decomposition of a^T a, the
+//! columns of u follow from a v and the last one is the cross product of the others, so rank deficient
+//! matrices (e.g. the covariance of a planar trajectory) still give rotations
+inline void svd3(const linalg::mat<double, 3, 3>& a, linalg::mat<double, 3, 3>& u,
+                 linalg::vec<double, 3>& s, linalg::mat<double, 3, 3>& v);
+
+//  +--------------------------------------------------------
+//  |       Pose resampling
+//  +--------------------------------------------------------
+//  |
+//  | Poses at regular steps of a key (time or distance along the path),
+//  | interpolated between the two poses surrounding each sample: linear
+//  | interpolation of the positions and SLERP of the orientations. The
+//  | SLERP coefficients come from the polynomial approximation of
+//  | Eberly ("A Fast and Accurate Algorithm for Computing SLERP"), with
+//  | no trigonometric function and no branch, so 4 samples are
+//  | interpolated at once in SSE lanes. The error is below the float
+//  | rounding for rotations smaller than 90 degrees between two poses
+//  |
+//  +--------------------------------------------------------
+
+//! out[i] = pose between poses[segments[i]] and poses[segments[i] + 1] at the fraction weights[i] in [0, 1],
+//! the orientation follows the shortest arc
+inline void interpolate_poses(const Camera_pose* poses, const size_t* segments, const float* weights,
+                              Camera_pose* out, const size_t count);
+
+//! length of the path through the camera centers from the first pose to each pose
+inline std::vector<double> arc_lengths(const std::vector<Camera_pose>& poses);
+
+//! poses at the keys keys[0] + k * step (k = 0, 1...) up to the last key, the keys (e.g. timestamps or
+//! arc_lengths) should be non decreasing with one key per pose. The samples are computed in parallel
+inline std::vector<Camera_pose> resample_poses(const std::vector<Camera_pose>& poses,
+                                               const std::vector<double>& keys,
+                                               const double step);
+
+//! camera frame change from a named convention to the one of the viewer (x right, y down, z forward):
+//! "opencv" and "ros_optical" (identity), "opengl" (x right, y up, z backward) and "ros" (x forward, y left, z up)
+inline Pose_transform frame_convention(const std::string name);
+
+//! Ramer-Douglas-Peucker simplification: returns the indices of the points kept so that no removed
+//! point is farther than tolerance from the simplified polyline, the first and last points are always kept
+inline std::vector<size_t> simplify_polyline(const std::vector<linalg::vec<float, 2>>& points,
+                                             const float tolerance);
+
 template<typename T> void printv(const T vec, const size_t vec_size, const std::string prefix = "");
 
 template<typename T> void printm(const T mat, const size_t rows, const size_t cols, const std::string prefix = "");
@@ -1,5 +1,6 @@
     #pragma once
 #include "marithmetic.hpp"
+#include "parallel.hpp"
 
 #include <cmath>
 #include <iostream>
@@ -7,6 +8,14 @@
 #include <iomanip>
 #include <vector>
 #include <limits>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+#if !defined(SLAM_VIEWER_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#   define SLAM_VIEWER_SSE
+#   include <xmmintrin.h>
+#endif
 
 
 Slam_viewer::Quaternion Slam_viewer::Marithmetic::multiply(const Quaternion& a,
@@ -175,6 +184,605 @@ inline Slam_viewer::Quaternion Slam_viewer::Marithmetic::normalize(const Quatern
 
 
 
+namespace Slam_viewer {
+namespace Marithmetic {
+namespace detail {
+
+#ifdef SLAM_VIEWER_SSE
+// four floats in one SSE register, one lane per quaternion
+struct Float4 {
+    __m128 v;
+};
+inline Float4 operator+(const Float4 a, const Float4 b) {return {_mm_add_ps(a.v, b.v)};}
+inline Float4 operator-(const Float4 a, const Float4 b) {return {_mm_sub_ps(a.v, b.v)};}
+inline Float4 operator*(const Float4 a, const Float4 b) {return {_mm_mul_ps(a.v, b.v)};}
+inline Float4 operator/(const Float4 a, const Float4 b) {return {_mm_div_ps(a.v, b.v)};}
+inline Float4 operator*(const Float4 a, const float b) {return {_mm_mul_ps(a.v, _mm_set1_ps(b))};}
+inline Float4 lanes_sqrt(const Float4 a) {return {_mm_sqrt_ps(a.v)};}
+inline Float4 broadcast(const float a, Float4) {return {_mm_set1_ps(a)};}
+inline Float4 lanes_abs(const Float4 a) {return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)};}
+// magnitude of a with the sign of b
+inline Float4 lanes_copysign(const Float4 a, const Float4 b)
+{
+    const __m128 sign = _mm_set1_ps(-0.f);
+    return {_mm_or_ps(_mm_andnot_ps(sign, a.v), _mm_and_ps(sign, b.v))};
+}
+
+// load 4 quaternions and transpose them to x, y, z, w lanes
+inline void load_lanes(const Quaternion* q, Float4& x, Float4& y, Float4& z, Float4& w)
+{
+    __m128 r0 = _mm_loadu_ps(&q[0].x), r1 = _mm_loadu_ps(&q[1].x);
+    __m128 r2 = _mm_loadu_ps(&q[2].x), r3 = _mm_loadu_ps(&q[3].x);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    x.v = r0; y.v = r1; z.v = r2; w.v = r3;
+}
+
+// same as above for 4 quaternions anywhere in memory
+inline void load_lanes(const Quaternion* q0, const Quaternion* q1, const Quaternion* q2, const Quaternion* q3,
+                       Float4& x, Float4& y, Float4& z, Float4& w)
+{
+    __m128 r0 = _mm_loadu_ps(&q0->x), r1 = _mm_loadu_ps(&q1->x);
+    __m128 r2 = _mm_loadu_ps(&q2->x), r3 = _mm_loadu_ps(&q3->x);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    x.v = r0; y.v = r1; z.v = r2; w.v = r3;
+}
+
+inline void store_lanes(Float4 x, Float4 y, Float4 z, Float4 w, Quaternion* q)
+{
+    _MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+    _mm_storeu_ps(&q[0].x, x.v);
+    _mm_storeu_ps(&q[1].x, y.v);
+    _mm_storeu_ps(&q[2].x, z.v);
+    _mm_storeu_ps(&q[3].x, w.v);
+}
+#endif
+
+inline float lanes_sqrt(const float a) {return std::sqrt(a);}
+inline float broadcast(const float a, float) {return a;}
+inline float lanes_abs(const float a) {return std::abs(a);}
+inline float lanes_copysign(const float a, const float b) {return std::copysign(a, b);}
+inline double lanes_sqrt(const double a) {return std::sqrt(a);}
+inline double broadcast(const float a, double) {return a;}
+inline double lanes_abs(const double a) {return std::abs(a);}
+inline double lanes_copysign(const double a, const double b) {return std::copysign(a, b);}
+
+// the kernels are written once for a scalar or a SIMD lane type F, with the
+// same operations order as the scalar functions so the results match exactly
+
+template<typename F>
+void normalize_lanes(F& x, F& y, F& z, F& w)
+{
+    const F norm = lanes_sqrt(x * x + y * y + z * z + w * w);
+    x = x / norm;
+    y = y / norm;
+    z = z / norm;
+    w = w / norm;
+}
+
+// r = a * b, r may be a or b
+template<typename F>
+void product_lanes(const F& ax, const F& ay, const F& az, const F& aw,
+                   const F& bx, const F& by, const F& bz, const F& bw,
+                   F& rx, F& ry, F& rz, F& rw)
+{
+    const F x = ax * bw + aw * bx + ay * bz - az * by;
+    const F y = ay * bw + aw * by + az * bx - ax * bz;
+    const F z = az * bw + aw * bz + ax * by - ay * bx;
+    const F w = aw * bw - ax * bx - ay * by - az * bz;
+    rx = x; ry = y; rz = z; rw = w;
+}
+
+template<typename F>
+void multiply_lanes(F& x, F& y, F& z, F& w, const Quaternion& b)
+{
+    const F bx = broadcast(b.x, x), by = broadcast(b.y, x), bz = broadcast(b.z, x), bw = broadcast(b.w, x);
+    product_lanes(x, y, z, w, bx, by, bz, bw, x, y, z, w);
+}
+
+// v = q v q*, computed as v + w t + u x t with t = 2 u x v
+template<typename F>
+void rotate_lanes(const F& qx, const F& qy, const F& qz, const F& qw, F& vx, F& vy, F& vz)
+{
+    const F tx = (qy * vz - qz * vy) * 2.f;
+    const F ty = (qz * vx - qx * vz) * 2.f;
+    const F tz = (qx * vy - qy * vx) * 2.f;
+    const F rx = vx + qw * tx + (qy * tz - qz * ty);
+    const F ry = vy + qw * ty + (qz * tx - qx * tz);
+    const F rz = vz + qw * tz + (qx * ty - qy * tx);
+    vx = rx; vy = ry; vz = rz;
+}
+
+// p and q hold the x, y, z and x, y, z, w lanes of the poses
+template<typename F>
+void transform_lanes(F p[3], F q[4], const Pose_transform& t)
+{
+    if(t.invert){
+        // inverse pose: q* and -(q* p q)
+        q[0] = q[0] * -1.f;
+        q[1] = q[1] * -1.f;
+        q[2] = q[2] * -1.f;
+        rotate_lanes(q[0], q[1], q[2], q[3], p[0], p[1], p[2]);
+        p[0] = p[0] * -1.f;
+        p[1] = p[1] * -1.f;
+        p[2] = p[2] * -1.f;
+    }
+    const F rx = broadcast(t.rotation.x, p[0]), ry = broadcast(t.rotation.y, p[0]);
+    const F rz = broadcast(t.rotation.z, p[0]), rw = broadcast(t.rotation.w, p[0]);
+    if(t.left){
+        rotate_lanes(rx, ry, rz, rw, p[0], p[1], p[2]);
+        p[0] = p[0] * t.scale + broadcast(t.translation.x, p[0]);
+        p[1] = p[1] * t.scale + broadcast(t.translation.y, p[0]);
+        p[2] = p[2] * t.scale + broadcast(t.translation.z, p[0]);
+        product_lanes(rx, ry, rz, rw, q[0], q[1], q[2], q[3], q[0], q[1], q[2], q[3]);
+    } else {
+        F d[3] = {broadcast(t.translation.x, p[0]), broadcast(t.translation.y, p[0]),
+                  broadcast(t.translation.z, p[0])};
+        rotate_lanes(q[0], q[1], q[2], q[3], d[0], d[1], d[2]);
+        p[0] = p[0] + d[0];
+        p[1] = p[1] + d[1];
+        p[2] = p[2] + d[2];
+        product_lanes(q[0], q[1], q[2], q[3], rx, ry, rz, rw, q[0], q[1], q[2], q[3]);
+    }
+}
+
+// rows of the rotation matrix, as transpose(linalg::qmat(q)) in to_rot_matrix3
+template<typename F>
+void rotation_lanes(const F& x, const F& y, const F& z, const F& w, F m[3][3])
+{
+    m[0][0] = w * w + x * x - y * y - z * z;
+    m[0][1] = (x * y + z * w) * 2;
+    m[0][2] = (z * x - y * w) * 2;
+    m[1][0] = (x * y - z * w) * 2;
+    m[1][1] = w * w - x * x + y * y - z * z;
+    m[1][2] = (y * z + x * w) * 2;
+    m[2][0] = (z * x + y * w) * 2;
+    m[2][1] = (y * z - x * w) * 2;
+    m[2][2] = w * w - x * x - y * y + z * z;
+}
+
+// cyclic Jacobi: a is the symmetric matrix, diagonalized in place, v gathers the rotations (the eigenvectors)
+template<typename F>
+void jacobi_lanes(F a[3][3], F v[3][3])
+{
+    const int pairs[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+    for(int r = 0; r < 3; r++)
+        for(int c = 0; c < 3; c++)
+            v[r][c] = broadcast(r == c ? 1.f : 0.f, a[0][0]);
+
+    for(int sweep = 0; sweep < 5; sweep++){
+        for(int k = 0; k < 3; k++){
+            const int p = pairs[k][0], q = pairs[k][1], r = 3 - p - q;
+
+            // t = tan of the angle cancelling a[p][q], the root of t^2 + t d / a[p][q] - 1 = 0 with the
+            // smallest magnitude (Numerical Recipes), written without branch: t = 0 when a[p][q] = 0
+            const F d = a[q][q] - a[p][p];
+            const F h = a[p][q] * 2.f;
+            const F t = lanes_copysign(broadcast(1.f, d), d) * h
+                    / (lanes_abs(d) + lanes_sqrt(d * d + h * h) + broadcast(std::numeric_limits<float>::min(), d));
+            const F c = broadcast(1.f, d) / lanes_sqrt(t * t + broadcast(1.f, d));
+            const F s = t * c;
+            const F tau = s / (broadcast(1.f, d) + c);
+
+            const F apq = a[p][q];
+            a[p][p] = a[p][p] - t * apq;
+            a[q][q] = a[q][q] + t * apq;
+            a[p][q] = a[q][p] = broadcast(0.f, d);
+            const F arp = a[r][p], arq = a[r][q];
+            a[r][p] = a[p][r] = arp - s * (arq + tau * arp);
+            a[r][q] = a[q][r] = arq + s * (arp - tau * arq);
+            for(int j = 0; j < 3; j++){
+                const F vjp = v[j][p], vjq = v[j][q];
+                v[j][p] = vjp - s * (vjq + tau * vjp);
+                v[j][q] = vjq + s * (vjp - tau * vjq);
+            }
+        }
+    }
+}
+
+
+// p, q = pose at the fraction t between (p0, q0) and (p1, q1)
+template<typename F>
+void interpolate_lanes(const F p0[3], const F q0[4], const F p1[3], const F q1[4], const F t, F p[3], F q[4])
+{
+    const F one = broadcast(1.f, t);
+    for(int k = 0; k < 3; k++)
+        p[k] = p0[k] + (p1[k] - p0[k]) * t;
+
+    // sin((1 - t) a) / sin(a) and sin(t a) / sin(a) as polynomials of cos(a) = |q0.q1|,
+    // the last coefficients are corrected by mu to balance the error of the truncation
+    const float mu = 1.85298109240830f;
+    const float u[8] = {1.f / (1 * 3), 1.f / (2 * 5), 1.f / (3 * 7), 1.f / (4 * 9),
+                        1.f / (5 * 11), 1.f / (6 * 13), 1.f / (7 * 15), mu / (8 * 17)};
+    const float v[8] = {1.f / 3, 2.f / 5, 3.f / 7, 4.f / 9, 5.f / 11, 6.f / 13, 7.f / 15, mu * 8 / 17};
+    const F dot = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+    const F x_minus_1 = lanes_abs(dot) - one;
+    const F d = one - t;
+    const F d2 = d * d;
+    const F t2 = t * t;
+    F c0 = one, c1 = one;
+    for(int i = 7; i >= 0; i--){
+        c0 = one + (d2 * u[i] - broadcast(v[i], t)) * x_minus_1 * c0;
+        c1 = one + (t2 * u[i] - broadcast(v[i], t)) * x_minus_1 * c1;
+    }
+    c0 = c0 * d;
+    // q1 and -q1 are the same rotation, the closest one to q0 gives the shortest arc
+    c1 = lanes_copysign(c1 * t, dot);
+    for(int k = 0; k < 4; k++)
+        q[k] = q0[k] * c0 + q1[k] * c1;
+    normalize_lanes(q[0], q[1], q[2], q[3]);
+}
+
+}
+}
+}
+
+void Slam_viewer::Marithmetic::normalize(const Quaternion* in, Quaternion* out, const size_t count)
+{
+    size_t i = 0;
+#ifdef SLAM_VIEWER_SSE
+    for(; i + 4 <= count; i += 4){
+        detail::Float4 x, y, z, w;
+        detail::load_lanes(in + i, x, y, z, w);
+        detail::normalize_lanes(x, y, z, w);
+        detail::store_lanes(x, y, z, w, out + i);
+    }
+#endif
+    for(; i < count; i++){
+        Quaternion q = in[i];
+        detail::normalize_lanes(q.x, q.y, q.z, q.w);
+        out[i] = q;
+    }
+}
+
+void Slam_viewer::Marithmetic::multiply(const Quaternion* in, const Quaternion& q, Quaternion* out, const size_t count)
+{
+    const Quaternion b = q;  // q may be one of the elements of out
+    size_t i = 0;
+#ifdef SLAM_VIEWER_SSE
+    for(; i + 4 <= count; i += 4){
+        detail::Float4 x, y, z, w;
+        detail::load_lanes(in + i, x, y, z, w);
+        detail::multiply_lanes(x, y, z, w, b);
+        detail::store_lanes(x, y, z, w, out + i);
+    }
+#endif
+    for(; i < count; i++){
+        Quaternion a = in[i];
+        detail::multiply_lanes(a.x, a.y, a.z, a.w, b);
+        out[i] = a;
+    }
+}
+
+void Slam_viewer::Marithmetic::to_rot_matrix3(const Quaternion* in, linalg::mat<float, 3, 3>* out, const size_t count)
+{
+    size_t i = 0;
+#ifdef SLAM_VIEWER_SSE
+    for(; i + 4 <= count; i += 4){
+        detail::Float4 x, y, z, w;
+        detail::load_lanes(in + i, x, y, z, w);
+        detail::Float4 m[3][3];
+        detail::rotation_lanes(x, y, z, w, m);
+        alignas(16) float lanes[3][3][4];
+        for(int r = 0; r < 3; r++)
+            for(int c = 0; c < 3; c++)
+                _mm_store_ps(lanes[r][c], m[r][c].v);
+        for(int k = 0; k < 4; k++)
+            for(int r = 0; r < 3; r++)
+                for(int c = 0; c < 3; c++)
+                    out[i + k][c][r] = lanes[r][c][k];
+    }
+#endif
+    for(; i < count; i++){
+        float m[3][3];
+        detail::rotation_lanes(in[i].x, in[i].y, in[i].z, in[i].w, m);
+        for(int r = 0; r < 3; r++)
+            for(int c = 0; c < 3; c++)
+                out[i][c][r] = m[r][c];
+    }
+}
+
+void Slam_viewer::Marithmetic::transform_poses(const Camera_pose* in, Camera_pose* out, const size_t count,
+                                               const Pose_transform& transform)
+{
+    const Pose_transform t = transform;  // transform may refer to memory written in out
+    size_t i = 0;
+#ifdef SLAM_VIEWER_SSE
+    // the 7 floats of a pose do not fit a register, lanes are gathered and scattered one value at a time
+    for(; i + 4 <= count; i += 4){
+        const Camera_pose* c = in + i;
+        detail::Float4 p[3] = {{_mm_setr_ps(c[0].p.x, c[1].p.x, c[2].p.x, c[3].p.x)},
+                               {_mm_setr_ps(c[0].p.y, c[1].p.y, c[2].p.y, c[3].p.y)},
+                               {_mm_setr_ps(c[0].p.z, c[1].p.z, c[2].p.z, c[3].p.z)}};
+        detail::Float4 q[4] = {{_mm_setr_ps(c[0].q.x, c[1].q.x, c[2].q.x, c[3].q.x)},
+                               {_mm_setr_ps(c[0].q.y, c[1].q.y, c[2].q.y, c[3].q.y)},
+                               {_mm_setr_ps(c[0].q.z, c[1].q.z, c[2].q.z, c[3].q.z)},
+                               {_mm_setr_ps(c[0].q.w, c[1].q.w, c[2].q.w, c[3].q.w)}};
+        detail::transform_lanes(p, q, t);
+        alignas(16) float lanes[7][4];
+        for(int k = 0; k < 3; k++)
+            _mm_store_ps(lanes[k], p[k].v);
+        for(int k = 0; k < 4; k++)
+            _mm_store_ps(lanes[3 + k], q[k].v);
+        for(int k = 0; k < 4; k++)
+            out[i + k] = {{lanes[0][k], lanes[1][k], lanes[2][k]},
+                          {lanes[3][k], lanes[4][k], lanes[5][k], lanes[6][k]}};
+    }
+#endif
+    for(; i < count; i++){
+        float p[3] = {in[i].p.x, in[i].p.y, in[i].p.z};
+        float q[4] = {in[i].q.x, in[i].q.y, in[i].q.z, in[i].q.w};
+        detail::transform_lanes(p, q, t);
+        out[i] = {{p[0], p[1], p[2]}, {q[0], q[1], q[2], q[3]}};
+    }
+}
+
+void Slam_viewer::Marithmetic::eigen_symmetric3(const Covariance* in, linalg::vec<float, 3>* eigenvalues,
+                                                linalg::mat<float, 3, 3>* eigenvectors, const size_t count)
+{
+    size_t i = 0;
+#ifdef SLAM_VIEWER_SSE
+    for(; i + 4 <= count; i += 4){
+        const Covariance* c = in + i;
+        const detail::Float4 xx = {_mm_setr_ps(c[0].xx, c[1].xx, c[2].xx, c[3].xx)};
+        const detail::Float4 xy = {_mm_setr_ps(c[0].xy, c[1].xy, c[2].xy, c[3].xy)};
+        const detail::Float4 xz = {_mm_setr_ps(c[0].xz, c[1].xz, c[2].xz, c[3].xz)};
+        const detail::Float4 yy = {_mm_setr_ps(c[0].yy, c[1].yy, c[2].yy, c[3].yy)};
+        const detail::Float4 yz = {_mm_setr_ps(c[0].yz, c[1].yz, c[2].yz, c[3].yz)};
+        const detail::Float4 zz = {_mm_setr_ps(c[0].zz, c[1].zz, c[2].zz, c[3].zz)};
+        detail::Float4 a[3][3] = {{xx, xy, xz}, {xy, yy, yz}, {xz, yz, zz}};
+        detail::Float4 v[3][3];
+        detail::jacobi_lanes(a, v);
+        alignas(16) float values[3][4], vectors[3][3][4];
+        for(int r = 0; r < 3; r++){
+            _mm_store_ps(values[r], a[r][r].v);
+            for(int col = 0; col < 3; col++)
+                _mm_store_ps(vectors[r][col], v[r][col].v);
+        }
+        for(int k = 0; k < 4; k++){
+            eigenvalues[i + k] = {values[0][k], values[1][k], values[2][k]};
+            for(int r = 0; r < 3; r++)
+                for(int col = 0; col < 3; col++)
+                    eigenvectors[i + k][col][r] = vectors[r][col][k];
+        }
+    }
+#endif
+    for(; i < count; i++){
+        const Covariance& c = in[i];
+        float a[3][3] = {{c.xx, c.xy, c.xz}, {c.xy, c.yy, c.yz}, {c.xz, c.yz, c.zz}};
+        float v[3][3];
+        detail::jacobi_lanes(a, v);
+        eigenvalues[i] = {a[0][0], a[1][1], a[2][2]};
+        for(int r = 0; r < 3; r++)
+            for(int col = 0; col < 3; col++)
+                eigenvectors[i][col][r] = v[r][col];
+    }
+}
+
+void Slam_viewer::Marithmetic::interpolate_poses(const Camera_pose* poses, const size_t* segments, const float* weights,
+                                                 Camera_pose* out, const size_t count)
+{
+    size_t i = 0;
+#ifdef SLAM_VIEWER_SSE
+    for(; i + 4 <= count; i += 4){
+        const Camera_pose* a[4] = {poses + segments[i], poses + segments[i + 1],
+                                   poses + segments[i + 2], poses + segments[i + 3]};
+        const Camera_pose* b[4] = {a[0] + 1, a[1] + 1, a[2] + 1, a[3] + 1};
+        const detail::Float4 p0[3] = {{_mm_setr_ps(a[0]->p.x, a[1]->p.x, a[2]->p.x, a[3]->p.x)},
+                                      {_mm_setr_ps(a[0]->p.y, a[1]->p.y, a[2]->p.y, a[3]->p.y)},
+                                      {_mm_setr_ps(a[0]->p.z, a[1]->p.z, a[2]->p.z, a[3]->p.z)}};
+        const detail::Float4 p1[3] = {{_mm_setr_ps(b[0]->p.x, b[1]->p.x, b[2]->p.x, b[3]->p.x)},
+                                      {_mm_setr_ps(b[0]->p.y, b[1]->p.y, b[2]->p.y, b[3]->p.y)},
+                                      {_mm_setr_ps(b[0]->p.z, b[1]->p.z, b[2]->p.z, b[3]->p.z)}};
+        detail::Float4 q0[4], q1[4];
+        detail::load_lanes(&a[0]->q, &a[1]->q, &a[2]->q, &a[3]->q, q0[0], q0[1], q0[2], q0[3]);
+        detail::load_lanes(&b[0]->q, &b[1]->q, &b[2]->q, &b[3]->q, q1[0], q1[1], q1[2], q1[3]);
+        const detail::Float4 t = {_mm_loadu_ps(weights + i)};
+        detail::Float4 p[3], q[4];
+        detail::interpolate_lanes(p0, q0, p1, q1, t, p, q);
+        alignas(16) float lanes[7][4];
+        for(int k = 0; k < 3; k++)
+            _mm_store_ps(lanes[k], p[k].v);
+        for(int k = 0; k < 4; k++)
+            _mm_store_ps(lanes[3 + k], q[k].v);
+        for(int k = 0; k < 4; k++)
+            out[i + k] = {{lanes[0][k], lanes[1][k], lanes[2][k]},
+                          {lanes[3][k], lanes[4][k], lanes[5][k], lanes[6][k]}};
+    }
+#endif
+    for(; i < count; i++){
+        const Camera_pose& a = poses[segments[i]];
+        const Camera_pose& b = poses[segments[i] + 1];
+        const float p0[3] = {a.p.x, a.p.y, a.p.z};
+        const float q0[4] = {a.q.x, a.q.y, a.q.z, a.q.w};
+        const float p1[3] = {b.p.x, b.p.y, b.p.z};
+        const float q1[4] = {b.q.x, b.q.y, b.q.z, b.q.w};
+        float p[3], q[4];
+        detail::interpolate_lanes(p0, q0, p1, q1, weights[i], p, q);
+        out[i] = {{p[0], p[1], p[2]}, {q[0], q[1], q[2], q[3]}};
+    }
+}
+
+std::vector<double> Slam_viewer::Marithmetic::arc_lengths(const std::vector<Camera_pose>& poses)
+{
+    std::vector<double> lengths(poses.size(), 0);
+    Parallel::parallel_for(1, poses.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const double dx = static_cast<double>(poses[i].p.x) - poses[i - 1].p.x;
+            const double dy = static_cast<double>(poses[i].p.y) - poses[i - 1].p.y;
+            const double dz = static_cast<double>(poses[i].p.z) - poses[i - 1].p.z;
+            lengths[i] = std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }, 4096);
+    for(size_t i = 1; i < lengths.size(); i++)
+        lengths[i] += lengths[i - 1];
+    return lengths;
+}
+
+std::vector<Slam_viewer::Camera_pose> Slam_viewer::Marithmetic::resample_poses(
+        const std::vector<Camera_pose>& poses,
+        const std::vector<double>& keys,
+        const double step)
+{
+    if(keys.size() != poses.size()){
+        throw std::runtime_error("In resample_poses: there should be one key per pose.");
+    }
+    if(!(step > 0)){
+        throw std::runtime_error("In resample_poses: the step should be positive.");
+    }
+    for(size_t i = 1; i < keys.size(); i++){
+        if(!(keys[i] >= keys[i - 1])){
+            throw std::runtime_error("In resample_poses: the keys decrease at pose " + std::to_string(i) + ".");
+        }
+    }
+    if(poses.size() < 2)
+        return poses;
+    const double span = (keys.back() - keys.front()) / step;
+    if(!(span < 1e12)){
+        throw std::runtime_error("In resample_poses: the step is too small for the range of the keys.");
+    }
+
+    const size_t size = poses.size();
+    const size_t num_samples = static_cast<size_t>(span) + 1;
+    std::vector<Camera_pose> samples(num_samples);
+    Parallel::parallel_for(0, num_samples, [&](size_t begin, size_t end){
+        // the segment of the first sample is searched, the segments of the next samples follow it
+        const double first_key = keys.front() + begin * step;
+        size_t segment = std::upper_bound(keys.begin(), keys.end(), first_key) - keys.begin();
+        segment = std::min(std::max<size_t>(segment, 1), size - 1) - 1;
+        const size_t block_size = 256;
+        size_t segments[block_size];
+        float weights[block_size];
+        for(size_t block = begin; block < end; block += block_size){
+            const size_t count = std::min(block_size, end - block);
+            for(size_t k = 0; k < count; k++){
+                const double key = keys.front() + (block + k) * step;
+                while(segment + 2 < size && keys[segment + 1] <= key)
+                    segment++;
+                const double gap = keys[segment + 1] - keys[segment];
+                const double weight = gap > 0 ? (key - keys[segment]) / gap : 0;
+                segments[k] = segment;
+                weights[k] = static_cast<float>(std::min(1.0, std::max(0.0, weight)));
+            }
+            interpolate_poses(poses.data(), segments, weights, samples.data() + block, count);
+        }
+    }, 4096);
+    return samples;
+}
+
+void Slam_viewer::Marithmetic::svd3(const linalg::mat<double, 3, 3>& a, linalg::mat<double, 3, 3>& u,
+                                    linalg::vec<double, 3>& s, linalg::mat<double, 3, 3>& v)
+{
+    // the right singular vectors are the eigenvectors of a^T a, sorted by decreasing eigenvalue
+    const linalg::mat<double, 3, 3> ata = linalg::mul(linalg::transpose(a), a);
+    double m[3][3], vectors[3][3];
+    for(int r = 0; r < 3; r++)
+        for(int c = 0; c < 3; c++)
+            m[r][c] = ata[c][r];
+    detail::jacobi_lanes(m, vectors);
+    int order[3] = {0, 1, 2};
+    std::sort(order, order + 3, [&](const int i, const int j){return m[i][i] > m[j][j];});
+    for(int c = 0; c < 3; c++)
+        v[c] = {vectors[0][order[c]], vectors[1][order[c]], vectors[2][order[c]]};
+    if(linalg::determinant(v) < 0)
+        v[2] = -v[2];
+
+    u = linalg::identity;
+    linalg::vec<double, 3> u0 = linalg::mul(a, v[0]);
+    const double length0 = linalg::length(u0);
+    if(length0 > 0){
+        u0 = u0 / length0;
+        // the second column is made orthogonal to the first one, or chosen freely for a rank 1 matrix
+        linalg::vec<double, 3> u1 = linalg::mul(a, v[1]);
+        u1 = u1 - u0 * linalg::dot(u0, u1);
+        if(linalg::length(u1) <= 1e-12 * length0){
+            const linalg::vec<double, 3> axis = std::abs(u0.x) < 0.5 ? linalg::vec<double, 3>{1, 0, 0}
+                                                                      : linalg::vec<double, 3>{0, 1, 0};
+            u1 = linalg::cross(u0, axis);
+        }
+        u1 = linalg::normalize(u1);
+        u = {u0, u1, linalg::cross(u0, u1)};
+    } else {
+        v = linalg::identity;
+    }
+    for(int k = 0; k < 3; k++)
+        s[k] = linalg::dot(u[k], linalg::mul(a, v[k]));
+}
+
+Slam_viewer::Pose_transform Slam_viewer::Marithmetic::frame_convention(const std::string name)
+{
+    Pose_transform transform;
+    transform.left = false;
+    if(name == "opencv" || name == "ros_optical"){
+        return transform;
+    } else if(name == "opengl"){
+        // half turn around x: y up becomes y down and z backward becomes z forward
+        transform.rotation = {1, 0, 0, 0};
+    } else if(name == "ros"){
+        // the optical axes expressed in the body frame: x = -y_body, y = -z_body, z = x_body
+        transform.rotation = {-0.5f, 0.5f, -0.5f, 0.5f};
+    } else {
+        throw std::runtime_error("In frame_convention: unknown convention '" + name
+                                 + "', it should be opencv, opengl, ros or ros_optical.");
+    }
+    return transform;
+}
+
+std::vector<size_t> Slam_viewer::Marithmetic::simplify_polyline(
+        const std::vector<linalg::vec<float, 2>>& points,
+        const float tolerance)
+{
+    std::vector<size_t> kept;
+    if(points.size() <= 2){
+        for(size_t i = 0; i < points.size(); i++)
+            kept.push_back(i);
+        return kept;
+    }
+
+    // iterative version with an explicit stack of ranges, deep recursions
+    // would overflow the call stack on millions of points
+    std::vector<uint8_t> keep(points.size(), 0);
+    keep.front() = keep.back() = 1;
+    std::vector<std::pair<size_t, size_t>> ranges = {{0, points.size() - 1}};
+    const float tolerance2 = tolerance * tolerance;
+    while(!ranges.empty()){
+        const size_t first = ranges.back().first;
+        const size_t last = ranges.back().second;
+        ranges.pop_back();
+
+        const linalg::vec<float, 2> a = points[first];
+        const linalg::vec<float, 2> ab = points[last] - a;
+        const float ab2 = linalg::dot(ab, ab);
+        float max_distance2 = -1;
+        size_t farthest = first;
+        for(size_t i = first + 1; i < last; i++){
+            const linalg::vec<float, 2> ap = points[i] - a;
+            float distance2;
+            if(ab2 > 0){
+                const float t = std::min(1.f, std::max(0.f, linalg::dot(ap, ab) / ab2));
+                const linalg::vec<float, 2> d = ap - ab * t;
+                distance2 = linalg::dot(d, d);
+            } else {
+                distance2 = linalg::dot(ap, ap);
+            }
+            if(distance2 > max_distance2){
+                max_distance2 = distance2;
+                farthest = i;
+            }
+        }
+        if(max_distance2 > tolerance2){
+            keep[farthest] = 1;
+            if(farthest - first > 1)
+                ranges.push_back({first, farthest});
+            if(last - farthest > 1)
+                ranges.push_back({farthest, last});
+        }
+    }
+    for(size_t i = 0; i < points.size(); i++)
+        if(keep[i])
+            kept.push_back(i);
+    return kept;
+}
+
 template<typename T> void Slam_viewer::Marithmetic::printv(
         const T vec, size_t size, const std::string prefix)
 {
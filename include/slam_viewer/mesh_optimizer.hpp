@@ -0,0 +1,35 @@
+#pragma once
+
+#include "viewer.hpp"
+
+#include <vector>
+
+
+namespace Slam_viewer {
+namespace Mesh_optimizer {
+
+//! reorder the triangles for the post-transform vertex cache of the GPU using the Tipsify algorithm
+//! (Sander et al. 2007 "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+inline std::vector<Triangle> tipsify(const std::vector<Triangle>& triangles,
+                                     const size_t num_vertices,
+                                     const size_t cache_size = 16);
+
+//! renumber the vertices in the order they are first used by the triangles (unused vertices come last),
+//! the triangles are updated in place and the returned array gives the old index of each new vertex
+inline std::vector<uint32_t> reorder_vertices_by_first_use(std::vector<Triangle>& triangles,
+                                                           const size_t num_vertices);
+
+//! simulate a FIFO vertex cache and return the number of cache misses (vertex shader invocations)
+inline size_t count_cache_misses(const std::vector<Triangle>& triangles,
+                                 const size_t num_vertices,
+                                 const size_t cache_size = 16);
+
+//! average cache miss ratio: the number of cache misses per triangle
+inline float acmr(const std::vector<Triangle>& triangles,
+                  const size_t num_vertices,
+                  const size_t cache_size = 16);
+
+}
+}
+
+#include "mesh_optimizer_impl.hpp"
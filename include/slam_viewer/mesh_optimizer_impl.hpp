@@ -0,0 +1,153 @@
+#pragma once
+#include "mesh_optimizer.hpp"
+
+#include <stdexcept>
+
+
+std::vector<Slam_viewer::Triangle> Slam_viewer::Mesh_optimizer::tipsify(
+        const std::vector<Triangle>& triangles,
+        const size_t num_vertices,
+        const size_t cache_size)
+{
+    // vertex -> triangles adjacency, stored as offsets in one array
+    std::vector<uint32_t> offsets(num_vertices + 1, 0);
+    for(auto& t: triangles){
+        if(t.a >= num_vertices || t.b >= num_vertices || t.c >= num_vertices)
+            throw std::runtime_error("In tipsify: triangle index out of range.");
+        offsets[t.a + 1]++;
+        offsets[t.b + 1]++;
+        offsets[t.c + 1]++;
+    }
+    for(size_t v = 0; v < num_vertices; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(offsets.back());
+    std::vector<uint32_t> live(num_vertices, 0);
+    for(uint32_t i = 0; i < triangles.size(); i++){
+        const uint32_t vs[3] = {triangles[i].a, triangles[i].b, triangles[i].c};
+        for(uint32_t v: vs)
+            adjacency[offsets[v] + live[v]++] = i;
+    }
+
+    std::vector<size_t> cache_time(num_vertices, 0);
+    std::vector<uint8_t> emitted(triangles.size(), 0);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<Triangle> result;
+    result.reserve(triangles.size());
+
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+    const int64_t none = -1;
+
+    // next vertex with live triangles: from the dead-end stack first, then in input order
+    auto skip_dead_end = [&]() -> int64_t {
+        while(!dead_end.empty()){
+            uint32_t d = dead_end.back();
+            dead_end.pop_back();
+            if(live[d] > 0)
+                return d;
+        }
+        while(cursor < num_vertices){
+            if(live[cursor] > 0)
+                return static_cast<int64_t>(cursor);
+            cursor++;
+        }
+        return none;
+    };
+
+    int64_t fan = skip_dead_end();
+    while(fan != none){
+        candidates.clear();
+        const uint32_t f = static_cast<uint32_t>(fan);
+        for(uint32_t k = offsets[f]; k < offsets[f + 1]; k++){
+            uint32_t t = adjacency[k];
+            if(emitted[t])
+                continue;
+            emitted[t] = 1;
+            result.push_back(triangles[t]);
+            const uint32_t vs[3] = {triangles[t].a, triangles[t].b, triangles[t].c};
+            for(uint32_t v: vs){
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(time - cache_time[v] > cache_size){
+                    cache_time[v] = time;
+                    time++;
+                }
+            }
+        }
+
+        // prefer the candidate which stays the longest in the cache while all its triangles are emitted
+        int64_t best = none;
+        int64_t best_priority = -1;
+        for(uint32_t v: candidates){
+            if(live[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if(time - cache_time[v] + 2 * live[v] <= cache_size)
+                priority = static_cast<int64_t>(time - cache_time[v]);
+            if(priority > best_priority){
+                best_priority = priority;
+                best = v;
+            }
+        }
+        fan = best != none ? best : skip_dead_end();
+    }
+    return result;
+}
+
+std::vector<uint32_t> Slam_viewer::Mesh_optimizer::reorder_vertices_by_first_use(
+        std::vector<Triangle>& triangles,
+        const size_t num_vertices)
+{
+    const uint32_t unset = 0xFFFFFFFFu;
+    std::vector<uint32_t> new_index(num_vertices, unset);
+    std::vector<uint32_t> old_index;
+    old_index.reserve(num_vertices);
+
+    auto renumber = [&](uint32_t& v){
+        if(new_index[v] == unset){
+            new_index[v] = static_cast<uint32_t>(old_index.size());
+            old_index.push_back(v);
+        }
+        v = new_index[v];
+    };
+    for(auto& t: triangles){
+        renumber(t.a);
+        renumber(t.b);
+        renumber(t.c);
+    }
+    for(uint32_t v = 0; v < num_vertices; v++)
+        if(new_index[v] == unset)
+            old_index.push_back(v);
+    return old_index;
+}
+
+size_t Slam_viewer::Mesh_optimizer::count_cache_misses(const std::vector<Triangle>& triangles,
+                                                       const size_t num_vertices,
+                                                       const size_t cache_size)
+{
+    // a vertex is in the FIFO cache if it entered it less than cache_size misses ago
+    std::vector<size_t> entered(num_vertices, 0);
+    size_t misses = 0;
+    for(auto& t: triangles){
+        const uint32_t vs[3] = {t.a, t.b, t.c};
+        for(uint32_t v: vs){
+            if(entered[v] == 0 || misses - entered[v] + 1 > cache_size){
+                misses++;
+                entered[v] = misses;
+            }
+        }
+    }
+    return misses;
+}
+
+float Slam_viewer::Mesh_optimizer::acmr(const std::vector<Triangle>& triangles,
+                                        const size_t num_vertices,
+                                        const size_t cache_size)
+{
+    if(triangles.empty())
+        return 0;
+    return static_cast<float>(count_cache_misses(triangles, num_vertices, cache_size))
+            / static_cast<float>(triangles.size());
+}
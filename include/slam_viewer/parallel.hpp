@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace Slam_viewer {
+namespace Parallel {
+
+//  +--------------------------------------------------------
+//  |       Minimal thread pool free parallel loops
+//  +--------------------------------------------------------
+//  |
+//  | Work is split between std::thread workers created for each call,
+//  | the first exception thrown by a worker is rethrown in the caller.
+//  | Loops started from inside a parallel loop run on the calling thread
+//  | only, so nested parallelism does not oversubscribe the cores
+//  |
+//  +--------------------------------------------------------
+
+//! set the number of threads used by the parallel loops, 0 means one per hardware thread
+inline void set_num_threads(const size_t num_threads);
+
+//! get the number of threads used by the parallel loops (1 from inside a parallel loop)
+inline size_t get_num_threads();
+
+//! split [begin, end) in contiguous chunks of at least min_chunk elements and call
+//! fn(chunk_begin, chunk_end) for each of them, one chunk per thread
+template<typename F>
+void parallel_for(const size_t begin, const size_t end, F fn, const size_t min_chunk = 4096);
+
+//! call fn(task) for each task in [0, num_tasks), threads pick the next task when done with the previous one
+template<typename F>
+void parallel_tasks(const size_t num_tasks, F fn);
+
+//! sort [first, last) with std::sort on one chunk per thread, the sorted chunks are then merged
+//! in parallel pairs. Like std::sort the order of equivalent elements is not kept
+template<typename It, typename Less>
+void parallel_sort(It first, It last, Less less);
+
+}
+}
+
+#include "parallel_impl.hpp"
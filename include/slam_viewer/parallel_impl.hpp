@@ -0,0 +1,147 @@
+#pragma once
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Slam_viewer {
+namespace Parallel {
+namespace detail {
+
+inline size_t& num_threads_setting()
+{
+    static size_t num_threads = 0;
+    return num_threads;
+}
+
+// true on the threads running a parallel loop, nested loops then run on their thread only
+inline bool& inside_parallel_loop()
+{
+    static thread_local bool inside = false;
+    return inside;
+}
+
+// run fn(thread_idx) on 'count' threads (the caller thread being one of them)
+template<typename F>
+void run_on_threads(const size_t count, F fn)
+{
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto guarded = [&](const size_t thread_idx){
+        const bool was_inside = inside_parallel_loop();
+        inside_parallel_loop() = count > 1 || was_inside;
+        try {
+            fn(thread_idx);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if(!error)
+                error = std::current_exception();
+        }
+        inside_parallel_loop() = was_inside;
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(count > 0 ? count - 1 : 0);
+    for(size_t t = 1; t < count; t++)
+        threads.emplace_back(guarded, t);
+    guarded(0);
+    for(auto& thread: threads)
+        thread.join();
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+}
+}
+}
+
+
+void Slam_viewer::Parallel::set_num_threads(const size_t num_threads)
+{
+    detail::num_threads_setting() = num_threads;
+}
+
+size_t Slam_viewer::Parallel::get_num_threads()
+{
+    if(detail::inside_parallel_loop())
+        return 1;
+    size_t num_threads = detail::num_threads_setting();
+    if(num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    return num_threads == 0 ? 1 : num_threads;
+}
+
+template<typename F>
+void Slam_viewer::Parallel::parallel_for(const size_t begin, const size_t end, F fn, const size_t min_chunk)
+{
+    if(end <= begin)
+        return;
+    const size_t size = end - begin;
+    const size_t max_chunks = std::max<size_t>(1, size / std::max<size_t>(1, min_chunk));
+    const size_t num_chunks = std::min(get_num_threads(), max_chunks);
+    if(num_chunks == 1){
+        fn(begin, end);
+        return;
+    }
+
+    detail::run_on_threads(num_chunks, [&](const size_t chunk){
+        size_t chunk_begin = begin + size * chunk / num_chunks;
+        size_t chunk_end = begin + size * (chunk + 1) / num_chunks;
+        fn(chunk_begin, chunk_end);
+    });
+}
+
+template<typename F>
+void Slam_viewer::Parallel::parallel_tasks(const size_t num_tasks, F fn)
+{
+    if(num_tasks == 0)
+        return;
+    const size_t num_threads = std::min(get_num_threads(), num_tasks);
+    std::atomic<size_t> next_task(0);
+    std::atomic<bool> failed(false);
+
+    detail::run_on_threads(num_threads, [&](const size_t){
+        try {
+            for(size_t task = next_task++; task < num_tasks && !failed; task = next_task++)
+                fn(task);
+        } catch (...) {
+            failed = true;
+            throw;
+        }
+    });
+}
+
+template<typename It, typename Less>
+void Slam_viewer::Parallel::parallel_sort(It first, It last, Less less)
+{
+    const size_t size = static_cast<size_t>(last - first);
+    const size_t num_chunks = std::min(get_num_threads(), std::max<size_t>(1, size / 65536));
+    if(num_chunks <= 1){
+        std::sort(first, last, less);
+        return;
+    }
+
+    std::vector<size_t> bounds(num_chunks + 1);
+    for(size_t chunk = 0; chunk <= num_chunks; chunk++)
+        bounds[chunk] = size * chunk / num_chunks;
+    parallel_tasks(num_chunks, [&](size_t chunk){
+        std::sort(first + bounds[chunk], first + bounds[chunk + 1], less);
+    });
+
+    // merge neighbouring sorted runs until one is left
+    for(size_t width = 1; width < num_chunks; width *= 2){
+        const size_t num_merges = (num_chunks + 2 * width - 1) / (2 * width);
+        parallel_tasks(num_merges, [&](size_t merge){
+            const size_t begin = bounds[2 * width * merge];
+            const size_t middle = bounds[std::min(num_chunks, 2 * width * merge + width)];
+            const size_t end = bounds[std::min(num_chunks, 2 * width * (merge + 1))];
+            std::inplace_merge(first + begin, first + middle, first + end, less);
+        });
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "viewer.hpp"
+
+#include <vector>
+
+
+namespace Slam_viewer {
+namespace Rasterizer {
+
+//  +--------------------------------------------------------
+//  |       Headless software rasterizer
+//  +--------------------------------------------------------
+//  |
+//  | Renders the trajectory geometry to an RGB image without any GPU or
+//  | window: the triangles are flat shaded with a head light and resolved
+//  | with a depth buffer, the edges are drawn as one pixel lines and the
+//  | points no element uses as single pixels.
+//  | The image is split in square tiles, the elements are binned by the
+//  | tiles their screen bounding box overlaps and the tiles are rendered
+//  | in parallel, each thread owning the pixels of its tile
+//  |
+//  +--------------------------------------------------------
+
+struct Render_settings {
+    size_t width {1024};
+    size_t height {768};
+    float vertical_fov_degrees {45};
+
+    //! if true then the camera looks at the center of the bounding box of the points
+    //! from view_direction, far enough to see all of them
+    bool automatic_view {true};
+    linalg::vec<float, 3> view_direction {0.5f, 0.7f, 1.0f};
+
+    //! camera used when automatic_view is false
+    linalg::vec<float, 3> eye {0, 0, -10};
+    linalg::vec<float, 3> target {0, 0, 0};
+
+    //! the up direction of the image, the camera y-axis points down in the usual slam frames
+    linalg::vec<float, 3> up {0, -1, 0};
+
+    Color background {255, 255, 255};
+    size_t tile_size {64};
+};
+
+//! render the triangles, edges and lone points and return the image as row major RGB bytes (3 * width * height)
+inline std::vector<uint8_t> render(const std::vector<Point>& points,
+                                   const std::vector<Triangle>& triangles,
+                                   const std::vector<Edge>& edges,
+                                   const Render_settings& settings);
+
+}
+}
+
+#include "rasterizer_impl.hpp"
@@ -0,0 +1,328 @@
+#pragma once
+#include "rasterizer.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace Slam_viewer {
+namespace Rasterizer {
+namespace detail {
+
+struct Screen_vertex {
+    float x, y;
+    float inv_z;  // 1/depth is affine in screen space, 0 marks a vertex behind the near plane
+};
+
+// area of the parallelogram (a, b, p), positive if p is on the right of a->b in image coordinates
+inline float edge_function(const Screen_vertex& a, const Screen_vertex& b, const float px, const float py)
+{
+    return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+struct Pixel_rect {
+    int x0, y0, x1, y1;  // [x0, x1) x [y0, y1)
+};
+
+// screen bounding box of the vertices clipped to the image, false if it is empty
+inline bool screen_bounds(const Screen_vertex* const* vertices, const int count,
+                          const int width, const int height, Pixel_rect& rect)
+{
+    float min_x = vertices[0]->x, max_x = vertices[0]->x;
+    float min_y = vertices[0]->y, max_y = vertices[0]->y;
+    for(int i = 1; i < count; i++){
+        min_x = std::min(min_x, vertices[i]->x);
+        max_x = std::max(max_x, vertices[i]->x);
+        min_y = std::min(min_y, vertices[i]->y);
+        max_y = std::max(max_y, vertices[i]->y);
+    }
+    if(max_x < 0 || max_y < 0 || min_x >= width || min_y >= height)
+        return false;
+    rect.x0 = static_cast<int>(std::max(0.f, std::floor(min_x)));
+    rect.y0 = static_cast<int>(std::max(0.f, std::floor(min_y)));
+    rect.x1 = static_cast<int>(std::min(static_cast<float>(width), std::floor(max_x) + 1));
+    rect.y1 = static_cast<int>(std::min(static_cast<float>(height), std::floor(max_y) + 1));
+    return rect.x0 < rect.x1 && rect.y0 < rect.y1;
+}
+
+// part [t0, t1] of the segment a->b inside the rectangle (Liang-Barsky), false if there is none
+inline bool clip_segment(const Screen_vertex& a, const Screen_vertex& b, const Pixel_rect& rect,
+                         float& t0, float& t1)
+{
+    const float dx = b.x - a.x, dy = b.y - a.y;
+    const float p[4] = {-dx, dx, -dy, dy};
+    const float q[4] = {a.x - rect.x0, rect.x1 - a.x, a.y - rect.y0, rect.y1 - a.y};
+    t0 = 0;
+    t1 = 1;
+    for(int i = 0; i < 4; i++){
+        if(p[i] == 0){
+            if(q[i] < 0)
+                return false;
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if(p[i] < 0)
+            t0 = std::max(t0, t);
+        else
+            t1 = std::min(t1, t);
+    }
+    return t0 <= t1;
+}
+
+inline uint8_t lerp_channel(const uint8_t a, const uint8_t b, const float t)
+{
+    return static_cast<uint8_t>(std::lround(a + (static_cast<float>(b) - a) * t));
+}
+
+}
+}
+}
+
+std::vector<uint8_t> Slam_viewer::Rasterizer::render(const std::vector<Point>& points,
+                                                     const std::vector<Triangle>& triangles,
+                                                     const std::vector<Edge>& edges,
+                                                     const Render_settings& settings)
+{
+    if(settings.width == 0 || settings.height == 0 || settings.tile_size == 0){
+        throw std::runtime_error("In render: the image and tile sizes should be positive.");
+    }
+    if(!(settings.vertical_fov_degrees > 0 && settings.vertical_fov_degrees < 180)){
+        throw std::runtime_error("In render: the field of view should be between 0 and 180 degrees.");
+    }
+    const int width = static_cast<int>(settings.width);
+    const int height = static_cast<int>(settings.height);
+    const float half_fov = settings.vertical_fov_degrees * 3.14159265f / 360.f;
+
+    // camera placement
+    linalg::vec<float, 3> eye = settings.eye;
+    linalg::vec<float, 3> target = settings.target;
+    if(settings.automatic_view){
+        linalg::vec<float, 3> min_corner {0, 0, 0}, max_corner {0, 0, 0};
+        if(!points.empty()){
+            min_corner = max_corner = {points[0].x, points[0].y, points[0].z};
+            for(auto& p: points){
+                min_corner = linalg::min(min_corner, linalg::vec<float, 3>{p.x, p.y, p.z});
+                max_corner = linalg::max(max_corner, linalg::vec<float, 3>{p.x, p.y, p.z});
+            }
+        }
+        const float radius = std::max(linalg::length(max_corner - min_corner) / 2, 1e-3f);
+        if(linalg::length(settings.view_direction) == 0){
+            throw std::runtime_error("In render: the view direction should not be null.");
+        }
+        target = (min_corner + max_corner) / 2.f;
+        eye = target - linalg::normalize(settings.view_direction) * (1.05f * radius / std::sin(half_fov));
+    }
+    const float distance = linalg::length(target - eye);
+    const linalg::vec<float, 3> forward = linalg::normalize(target - eye);
+    const linalg::vec<float, 3> right_raw = linalg::cross(-settings.up, forward);
+    if(!(distance > 0) || !(linalg::length(right_raw) > 1e-6f)){
+        throw std::runtime_error("In render: the eye, target and up vectors do not define a camera.");
+    }
+    const linalg::vec<float, 3> right = linalg::normalize(right_raw);
+    const linalg::vec<float, 3> down = linalg::cross(forward, right);
+    const float focal = 0.5f * height / std::tan(half_fov);
+    const float near = 1e-3f * distance;
+
+    // project the vertices, the camera frame is x right, y down and z forward
+    std::vector<detail::Screen_vertex> screen(points.size());
+    Parallel::parallel_for(0, points.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const linalg::vec<float, 3> d = linalg::vec<float, 3>{points[i].x, points[i].y, points[i].z} - eye;
+            const float z = linalg::dot(d, forward);
+            if(z < near){
+                screen[i] = {0, 0, 0};
+                continue;
+            }
+            screen[i] = {0.5f * width + focal * linalg::dot(d, right) / z,
+                         0.5f * height + focal * linalg::dot(d, down) / z,
+                         1 / z};
+        }
+    });
+
+    // flat shading with a light slightly above the eye, both sides of the triangles are lit
+    const linalg::vec<float, 3> light = linalg::normalize(-forward - 0.5f * down);
+    std::vector<Color> shaded(triangles.size());
+    Parallel::parallel_for(0, triangles.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const Triangle& t = triangles[i];
+            if(t.a >= points.size() || t.b >= points.size() || t.c >= points.size()){
+                throw std::runtime_error("In render: triangle index out of range.");
+            }
+            const Point& a = points[t.a];
+            const Point& b = points[t.b];
+            const Point& c = points[t.c];
+            const linalg::vec<float, 3> n = linalg::cross(linalg::vec<float, 3>{b.x - a.x, b.y - a.y, b.z - a.z},
+                                                          linalg::vec<float, 3>{c.x - a.x, c.y - a.y, c.z - a.z});
+            const float n_length = linalg::length(n);
+            const float lambert = n_length > 0 ? std::abs(linalg::dot(n, light)) / n_length : 1.f;
+            const float intensity = 0.35f + 0.65f * lambert;
+            shaded[i] = {static_cast<uint8_t>((a.c.r + b.c.r + c.c.r) / 3.f * intensity + 0.5f),
+                         static_cast<uint8_t>((a.c.g + b.c.g + c.c.g) / 3.f * intensity + 0.5f),
+                         static_cast<uint8_t>((a.c.b + b.c.b + c.c.b) / 3.f * intensity + 0.5f)};
+        }
+    });
+    for(auto& e: edges){
+        if(e.a >= points.size() || e.b >= points.size()){
+            throw std::runtime_error("In render: edge index out of range.");
+        }
+    }
+
+    // the points no triangle or edge uses (e.g. map points) are drawn as single pixels
+    std::vector<char> used(points.size(), 0);
+    for(auto& t: triangles)
+        used[t.a] = used[t.b] = used[t.c] = 1;
+    for(auto& e: edges)
+        used[e.a] = used[e.b] = 1;
+    std::vector<uint32_t> lone_points;
+    for(size_t i = 0; i < points.size(); i++)
+        if(!used[i])
+            lone_points.push_back(static_cast<uint32_t>(i));
+
+    // bin the elements by tile, one set of bins per chunk of elements so the
+    // binning runs in parallel and each tile still sees its elements in order
+    const int tile = static_cast<int>(settings.tile_size);
+    const int tiles_x = (width + tile - 1) / tile;
+    const int tiles_y = (height + tile - 1) / tile;
+    const size_t num_tiles = static_cast<size_t>(tiles_x) * tiles_y;
+    const size_t num_lines = triangles.size() + edges.size();
+    const size_t num_elements = num_lines + lone_points.size();
+    if(num_elements > std::numeric_limits<uint32_t>::max()){
+        throw std::runtime_error("In render: too many elements for 32 bits ids.");
+    }
+    const size_t num_chunks = std::max<size_t>(1, std::min(Parallel::get_num_threads(), num_elements / 4096));
+    // element ids below triangles.size() are triangles, then come the edges and the lone points
+    std::vector<std::vector<std::vector<uint32_t>>> bins(num_chunks, std::vector<std::vector<uint32_t>>(num_tiles));
+    Parallel::parallel_tasks(num_chunks, [&](size_t chunk){
+        const size_t begin = chunk * num_elements / num_chunks;
+        const size_t end = (chunk + 1) * num_elements / num_chunks;
+        for(size_t id = begin; id < end; id++){
+            const detail::Screen_vertex* v[3];
+            int count = 2;
+            if(id < triangles.size()){
+                v[0] = &screen[triangles[id].a];
+                v[1] = &screen[triangles[id].b];
+                v[2] = &screen[triangles[id].c];
+                count = 3;
+            } else if(id < num_lines){
+                v[0] = &screen[edges[id - triangles.size()].a];
+                v[1] = &screen[edges[id - triangles.size()].b];
+            } else {
+                v[0] = &screen[lone_points[id - num_lines]];
+                count = 1;
+            }
+            bool visible = true;
+            for(int k = 0; k < count; k++)
+                visible = visible && v[k]->inv_z > 0;
+            detail::Pixel_rect rect;
+            if(!visible || !detail::screen_bounds(v, count, width, height, rect))
+                continue;
+            for(int ty = rect.y0 / tile; ty <= (rect.y1 - 1) / tile; ty++)
+                for(int tx = rect.x0 / tile; tx <= (rect.x1 - 1) / tile; tx++)
+                    bins[chunk][static_cast<size_t>(ty) * tiles_x + tx].push_back(static_cast<uint32_t>(id));
+        }
+    });
+
+    std::vector<uint8_t> image(3 * settings.width * settings.height);
+    std::vector<float> depth(settings.width * settings.height, 0.f);
+    Parallel::parallel_tasks(num_tiles, [&](size_t tile_idx){
+        const detail::Pixel_rect area {static_cast<int>(tile_idx % tiles_x) * tile,
+                                       static_cast<int>(tile_idx / tiles_x) * tile,
+                                       std::min(width, static_cast<int>(tile_idx % tiles_x + 1) * tile),
+                                       std::min(height, static_cast<int>(tile_idx / tiles_x + 1) * tile)};
+        for(int y = area.y0; y < area.y1; y++){
+            for(int x = area.x0; x < area.x1; x++){
+                uint8_t* rgb = &image[3 * (static_cast<size_t>(y) * width + x)];
+                rgb[0] = settings.background.r;
+                rgb[1] = settings.background.g;
+                rgb[2] = settings.background.b;
+            }
+        }
+
+        for(size_t chunk = 0; chunk < num_chunks; chunk++){
+            for(uint32_t id: bins[chunk][tile_idx]){
+                if(id < triangles.size()){
+                    const detail::Screen_vertex& v0 = screen[triangles[id].a];
+                    const detail::Screen_vertex& v1 = screen[triangles[id].b];
+                    const detail::Screen_vertex& v2 = screen[triangles[id].c];
+                    const float area_2 = detail::edge_function(v0, v1, v2.x, v2.y);
+                    if(area_2 == 0)
+                        continue;
+                    const detail::Screen_vertex* v[3] = {&v0, &v1, &v2};
+                    detail::Pixel_rect rect;
+                    if(!detail::screen_bounds(v, 3, width, height, rect))
+                        continue;
+                    rect.x0 = std::max(rect.x0, area.x0);
+                    rect.y0 = std::max(rect.y0, area.y0);
+                    rect.x1 = std::min(rect.x1, area.x1);
+                    rect.y1 = std::min(rect.y1, area.y1);
+                    const float sign = area_2 > 0 ? 1.f : -1.f;
+                    const Color c = shaded[id];
+                    for(int y = rect.y0; y < rect.y1; y++){
+                        const float py = y + 0.5f;
+                        for(int x = rect.x0; x < rect.x1; x++){
+                            const float px = x + 0.5f;
+                            const float w0 = sign * detail::edge_function(v1, v2, px, py);
+                            const float w1 = sign * detail::edge_function(v2, v0, px, py);
+                            const float w2 = sign * detail::edge_function(v0, v1, px, py);
+                            if(w0 < 0 || w1 < 0 || w2 < 0)
+                                continue;
+                            const float inv_z = (w0 * v0.inv_z + w1 * v1.inv_z + w2 * v2.inv_z) / (sign * area_2);
+                            const size_t pixel = static_cast<size_t>(y) * width + x;
+                            if(inv_z <= depth[pixel])
+                                continue;
+                            depth[pixel] = inv_z;
+                            image[3 * pixel] = c.r;
+                            image[3 * pixel + 1] = c.g;
+                            image[3 * pixel + 2] = c.b;
+                        }
+                    }
+                } else if(id >= num_lines){
+                    const detail::Screen_vertex& v = screen[lone_points[id - num_lines]];
+                    const int x = static_cast<int>(std::floor(v.x));
+                    const int y = static_cast<int>(std::floor(v.y));
+                    if(x < area.x0 || x >= area.x1 || y < area.y0 || y >= area.y1)
+                        continue;
+                    const size_t pixel = static_cast<size_t>(y) * width + x;
+                    if(v.inv_z <= depth[pixel])
+                        continue;
+                    const Color& c = points[lone_points[id - num_lines]].c;
+                    depth[pixel] = v.inv_z;
+                    image[3 * pixel] = c.r;
+                    image[3 * pixel + 1] = c.g;
+                    image[3 * pixel + 2] = c.b;
+                } else {
+                    const Edge& e = edges[id - triangles.size()];
+                    const detail::Screen_vertex& a = screen[e.a];
+                    const detail::Screen_vertex& b = screen[e.b];
+                    float t0, t1;
+                    if(!detail::clip_segment(a, b, area, t0, t1))
+                        continue;
+                    const float length = std::max(std::abs(b.x - a.x), std::abs(b.y - a.y)) * (t1 - t0);
+                    const int steps = static_cast<int>(std::ceil(length)) + 1;
+                    const Color& ca = points[e.a].c;
+                    const Color& cb = points[e.b].c;
+                    for(int k = 0; k < steps; k++){
+                        const float t = steps > 1 ? t0 + (t1 - t0) * k / (steps - 1) : t0;
+                        const int x = static_cast<int>(std::floor(a.x + (b.x - a.x) * t));
+                        const int y = static_cast<int>(std::floor(a.y + (b.y - a.y) * t));
+                        if(x < area.x0 || x >= area.x1 || y < area.y0 || y >= area.y1)
+                            continue;
+                        // lines are pulled slightly towards the eye to stay visible on the faces they lie on
+                        const float inv_z = (a.inv_z + (b.inv_z - a.inv_z) * t) * 1.001f;
+                        const size_t pixel = static_cast<size_t>(y) * width + x;
+                        if(inv_z <= depth[pixel])
+                            continue;
+                        depth[pixel] = inv_z;
+                        image[3 * pixel] = detail::lerp_channel(ca.r, cb.r, t);
+                        image[3 * pixel + 1] = detail::lerp_channel(ca.g, cb.g, t);
+                        image[3 * pixel + 2] = detail::lerp_channel(ca.b, cb.b, t);
+                    }
+                }
+            }
+        }
+    });
+    return image;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "viewer.hpp"
+
+#include <vector>
+
+
+namespace Slam_viewer {
+namespace Spatial_hash {
+
+//  +--------------------------------------------------------
+//  |       Hashed uniform grid
+//  +--------------------------------------------------------
+//  |
+//  | Sorts the indices of the points by the cubic cell holding them, so
+//  | the points of a cell are contiguous and in increasing order, and
+//  | finds the cells in an open addressing hash table: only non-empty
+//  | cells are stored whatever the extent of the points.
+//  | Building the grid costs O(n log n) and finding a cell O(1)
+//  | PS: This class throws std::runtime_error in case of failure
+//  |
+//  +--------------------------------------------------------
+
+struct Cell {
+    int32_t x, y, z;
+};
+
+class Grid {
+public:
+    //! put the points in cubic cells of side cell_size, the points should be finite
+    inline Grid(const std::vector<linalg::vec<float, 3>>& points, const float cell_size);
+
+    //! the cell holding the point
+    inline Cell cell_of(const linalg::vec<float, 3>& point) const;
+
+    //! the index of the cell in [0, num_cells()), or num_cells() if no point lies in it
+    inline size_t find(const Cell& cell) const;
+
+    inline size_t num_cells() const {return m_cells.size();}
+
+    //! the indices of the points in the cell given by its index, in increasing order
+    inline const uint32_t* cell_begin(const size_t cell_idx) const {return m_order.data() + m_starts[cell_idx];}
+
+    inline const uint32_t* cell_end(const size_t cell_idx) const {return m_order.data() + m_starts[cell_idx + 1];}
+
+    //! hash of a cell, its low bits are well mixed
+    static inline uint64_t hash(const Cell& cell);
+
+private:
+
+    float m_inverse_size;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_starts;
+    std::vector<Cell> m_cells;
+    std::vector<uint32_t> m_table;
+    uint64_t m_table_mask {0};
+};
+
+//  +--------------------------------------------------------
+//  |       Streaming voxel grid downsampler
+//  +--------------------------------------------------------
+//  |
+//  | Replaces the points falling in the same cubic voxel by their
+//  | centroid with their mean color. The points are added in blocks as
+//  | they are read, only one running sum per non-empty voxel is kept,
+//  | so the memory grows with the number of voxels and not with the
+//  | number of points. The voxels are stored in the order of their first
+//  | point, which makes the output independent of the block sizes.
+//  | PS: This class throws std::runtime_error in case of failure
+//  |
+//  +--------------------------------------------------------
+
+class Voxel_downsampler {
+public:
+    //! voxels of side leaf_size, if leaf_size is 0 then every point is kept as it is
+    inline explicit Voxel_downsampler(const double leaf_size);
+
+    //! add the points whose positions are given by 3 doubles each, the positions should be finite
+    inline void add(const double* positions, const Color* colors, const size_t count);
+
+    //! number of points added so far
+    inline size_t num_added() const {return m_num_added;}
+
+    //! number of points points() would return
+    inline size_t size() const {return m_leaf_size > 0 ? m_voxels.size() : m_points.size();}
+
+    //! the centroids of the voxels with their mean colors, in the order of the voxels first points
+    inline std::vector<Point> points() const;
+
+private:
+    struct Voxel {
+        Cell cell;
+        uint64_t count;
+        double sum[3];
+        uint64_t color_sum[3];
+    };
+
+    inline void grow_table();
+
+    double m_leaf_size;
+    double m_inverse_size;
+    size_t m_num_added {0};
+    std::vector<Voxel> m_voxels;
+    std::vector<uint32_t> m_table;
+    uint64_t m_table_mask {0};
+    std::vector<Point> m_points;
+};
+
+//! find for each camera the closest earlier camera whose center is within radius and whose timestamp is
+//! smaller by at least min_time_gap, or without timestamps whose index is smaller by more than min_gap.
+//! The timestamps, one per pose, should be sorted; the revisits are sorted by pose index. The run time is
+//! linear in the number of cameras as long as few centers share the neighbourhood of a camera
+inline std::vector<Revisit> find_revisits(const std::vector<Camera_pose>& poses,
+                                          const float radius,
+                                          const size_t min_gap,
+                                          const std::vector<double>& timestamps = {},
+                                          const double min_time_gap = 0);
+
+}
+}
+
+#include "spatial_hash_impl.hpp"
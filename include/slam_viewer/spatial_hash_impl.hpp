@@ -0,0 +1,324 @@
+#pragma once
+#include "spatial_hash.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+
+Slam_viewer::Spatial_hash::Grid::Grid(const std::vector<linalg::vec<float, 3>>& points, const float cell_size)
+{
+    if(!(cell_size > 0)){
+        throw std::runtime_error("In Spatial_hash::Grid: the cell size should be positive.");
+    }
+    if(points.size() >= std::numeric_limits<uint32_t>::max()){
+        throw std::runtime_error("In Spatial_hash::Grid: too many points for 32 bits indices.");
+    }
+    m_inverse_size = 1 / cell_size;
+    const size_t size = points.size();
+
+    // the neighbour cells of any cell should also fit in 32 bits
+    const float limit = static_cast<float>(std::numeric_limits<int32_t>::max() / 2);
+    std::vector<Cell> cells(size);
+    std::vector<char> valid(size, 1);
+    Parallel::parallel_for(0, size, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const linalg::vec<float, 3> c = linalg::floor(points[i] * m_inverse_size);
+            if(!(std::abs(c.x) < limit && std::abs(c.y) < limit && std::abs(c.z) < limit)){
+                valid[i] = 0;
+                continue;
+            }
+            cells[i] = {static_cast<int32_t>(c.x), static_cast<int32_t>(c.y), static_cast<int32_t>(c.z)};
+        }
+    });
+    for(size_t i = 0; i < size; i++){
+        if(!valid[i]){
+            throw std::runtime_error("In Spatial_hash::Grid: point " + std::to_string(i)
+                                     + " is not finite or too far for the cell size.");
+        }
+    }
+
+    // points of the same cell become contiguous, in increasing order
+    m_order.resize(size);
+    Cell min_cell = size > 0 ? cells[0] : Cell{0, 0, 0};
+    Cell max_cell = min_cell;
+    for(const Cell& cell: cells){
+        min_cell = {std::min(min_cell.x, cell.x), std::min(min_cell.y, cell.y), std::min(min_cell.z, cell.z)};
+        max_cell = {std::max(max_cell.x, cell.x), std::max(max_cell.y, cell.y), std::max(max_cell.z, cell.z)};
+    }
+    const int64_t max_range = 1 << 21;
+    if(int64_t(max_cell.x) - min_cell.x < max_range && int64_t(max_cell.y) - min_cell.y < max_range
+            && int64_t(max_cell.z) - min_cell.z < max_range){
+        // the cells fit in a 63 bits key, sorting the keys with the indices avoids the indirections
+        struct Key {
+            uint64_t cell;
+            uint32_t idx;
+        };
+        std::vector<Key> keys(size);
+        Parallel::parallel_for(0, size, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++){
+                const Cell& cell = cells[i];
+                keys[i].cell = static_cast<uint64_t>(cell.x - min_cell.x) << 42
+                        | static_cast<uint64_t>(cell.y - min_cell.y) << 21
+                        | static_cast<uint64_t>(cell.z - min_cell.z);
+                keys[i].idx = static_cast<uint32_t>(i);
+            }
+        });
+        Parallel::parallel_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b){
+            return a.cell < b.cell || (a.cell == b.cell && a.idx < b.idx);
+        });
+        for(size_t k = 0; k < size; k++)
+            m_order[k] = keys[k].idx;
+    } else {
+        std::iota(m_order.begin(), m_order.end(), 0);
+        Parallel::parallel_sort(m_order.begin(), m_order.end(), [&](const uint32_t a, const uint32_t b){
+            const Cell& ca = cells[a];
+            const Cell& cb = cells[b];
+            if(ca.x != cb.x)
+                return ca.x < cb.x;
+            if(ca.y != cb.y)
+                return ca.y < cb.y;
+            if(ca.z != cb.z)
+                return ca.z < cb.z;
+            return a < b;
+        });
+    }
+    for(size_t k = 0; k < size; k++){
+        const Cell& cell = cells[m_order[k]];
+        if(k == 0 || cell.x != m_cells.back().x || cell.y != m_cells.back().y || cell.z != m_cells.back().z){
+            m_cells.push_back(cell);
+            m_starts.push_back(static_cast<uint32_t>(k));
+        }
+    }
+    m_starts.push_back(static_cast<uint32_t>(size));
+
+    // linear probing table at most half full
+    size_t capacity = 16;
+    while(capacity < 2 * m_cells.size())
+        capacity *= 2;
+    m_table.assign(capacity, std::numeric_limits<uint32_t>::max());
+    m_table_mask = capacity - 1;
+    for(size_t cell_idx = 0; cell_idx < m_cells.size(); cell_idx++){
+        uint64_t slot = hash(m_cells[cell_idx]) & m_table_mask;
+        while(m_table[slot] != std::numeric_limits<uint32_t>::max())
+            slot = (slot + 1) & m_table_mask;
+        m_table[slot] = static_cast<uint32_t>(cell_idx);
+    }
+}
+
+Slam_viewer::Spatial_hash::Cell Slam_viewer::Spatial_hash::Grid::cell_of(const linalg::vec<float, 3>& point) const
+{
+    const linalg::vec<float, 3> c = linalg::floor(point * m_inverse_size);
+    return {static_cast<int32_t>(c.x), static_cast<int32_t>(c.y), static_cast<int32_t>(c.z)};
+}
+
+size_t Slam_viewer::Spatial_hash::Grid::find(const Cell& cell) const
+{
+    uint64_t slot = hash(cell) & m_table_mask;
+    while(m_table[slot] != std::numeric_limits<uint32_t>::max()){
+        const Cell& candidate = m_cells[m_table[slot]];
+        if(candidate.x == cell.x && candidate.y == cell.y && candidate.z == cell.z)
+            return m_table[slot];
+        slot = (slot + 1) & m_table_mask;
+    }
+    return m_cells.size();
+}
+
+uint64_t Slam_viewer::Spatial_hash::Grid::hash(const Cell& cell)
+{
+    // large primes of Teschner et al. 2003, then mixed so the low bits used by the table differ
+    uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) * 73856093ull
+            ^ static_cast<uint64_t>(static_cast<uint32_t>(cell.y)) * 19349663ull
+            ^ static_cast<uint64_t>(static_cast<uint32_t>(cell.z)) * 83492791ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return h ^ (h >> 32);
+}
+
+std::vector<Slam_viewer::Revisit> Slam_viewer::Spatial_hash::find_revisits(
+        const std::vector<Camera_pose>& poses,
+        const float radius,
+        const size_t min_gap,
+        const std::vector<double>& timestamps,
+        const double min_time_gap)
+{
+    const bool timed = !timestamps.empty();
+    if(timed && timestamps.size() != poses.size()){
+        throw std::runtime_error("In Spatial_hash::find_revisits: " + std::to_string(timestamps.size())
+                                 + " timestamps for " + std::to_string(poses.size()) + " poses.");
+    }
+    for(size_t i = 1; i < timestamps.size(); i++){
+        if(timestamps[i] < timestamps[i - 1]){
+            throw std::runtime_error("In Spatial_hash::find_revisits: the timestamp of pose " + std::to_string(i)
+                                     + " is smaller than the previous one.");
+        }
+    }
+    std::vector<Revisit> revisits;
+    if(poses.empty())
+        return revisits;
+
+    std::vector<linalg::vec<float, 3>> centers(poses.size());
+    for(size_t i = 0; i < poses.size(); i++)
+        centers[i] = {poses[i].p.x, poses[i].p.y, poses[i].p.z};
+
+    // with cells of side 2 * radius, the centers within radius are in the 2x2x2 cells
+    // closest to the center, found from the half of its cell the center lies in
+    const Grid grid(centers, 2 * radius);
+    const float inverse_size = 1 / (2 * radius);
+    const float radius2 = radius * radius;
+    const uint32_t none = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> matches(poses.size(), none);
+    std::vector<float> distances(poses.size(), 0);
+
+    Parallel::parallel_for(0, poses.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const Cell cell = grid.cell_of(centers[i]);
+            const linalg::vec<float, 3> position = centers[i] * inverse_size;
+            const int32_t sx = position.x - cell.x < 0.5f ? -1 : 1;
+            const int32_t sy = position.y - cell.y < 0.5f ? -1 : 1;
+            const int32_t sz = position.z - cell.z < 0.5f ? -1 : 1;
+            float best = std::numeric_limits<float>::max();
+            uint32_t best_idx = none;
+            for(int32_t dz = 0; dz <= 1; dz++){
+                for(int32_t dy = 0; dy <= 1; dy++){
+                    for(int32_t dx = 0; dx <= 1; dx++){
+                        const size_t cell_idx = grid.find({cell.x + dx * sx, cell.y + dy * sy, cell.z + dz * sz});
+                        if(cell_idx == grid.num_cells())
+                            continue;
+                        for(const uint32_t* j = grid.cell_begin(cell_idx); j != grid.cell_end(cell_idx); j++){
+                            // the indices, hence the timestamps, are increasing, the next ones are too close in time
+                            if(timed ? *j >= i || timestamps[i] - timestamps[*j] < min_time_gap : *j + min_gap >= i)
+                                break;
+                            const float d2 = linalg::length2(centers[*j] - centers[i]);
+                            if(d2 <= radius2 && (d2 < best || (d2 == best && *j < best_idx))){
+                                best = d2;
+                                best_idx = *j;
+                            }
+                        }
+                    }
+                }
+            }
+            matches[i] = best_idx;
+            distances[i] = best_idx == none ? 0 : std::sqrt(best);
+        }
+    }, 1024);
+
+    for(size_t i = 0; i < poses.size(); i++)
+        if(matches[i] != none)
+            revisits.push_back({i, matches[i], distances[i]});
+    return revisits;
+}
+
+Slam_viewer::Spatial_hash::Voxel_downsampler::Voxel_downsampler(const double leaf_size)
+    : m_leaf_size(leaf_size), m_inverse_size(leaf_size > 0 ? 1 / leaf_size : 0)
+{
+    if(!(leaf_size >= 0)){
+        throw std::runtime_error("In Spatial_hash::Voxel_downsampler: the leaf size should not be negative.");
+    }
+    if(m_leaf_size > 0)
+        grow_table();
+}
+
+void Slam_viewer::Spatial_hash::Voxel_downsampler::add(const double* positions, const Color* colors, const size_t count)
+{
+    if(m_leaf_size == 0){
+        for(size_t i = 0; i < count; i++){
+            const double* p = positions + 3 * i;
+            m_points.push_back({static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2]), colors[i]});
+        }
+        m_num_added += count;
+        return;
+    }
+
+    // the cells are computed in parallel, the running sums are updated in the order of the points
+    const double limit = static_cast<double>(std::numeric_limits<int32_t>::max());
+    std::vector<Cell> cells(count);
+    std::vector<char> valid(count, 1);
+    Parallel::parallel_for(0, count, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const double* p = positions + 3 * i;
+            const double c[3] = {std::floor(p[0] * m_inverse_size),
+                                 std::floor(p[1] * m_inverse_size),
+                                 std::floor(p[2] * m_inverse_size)};
+            if(!(std::abs(c[0]) < limit && std::abs(c[1]) < limit && std::abs(c[2]) < limit)){
+                valid[i] = 0;
+                continue;
+            }
+            cells[i] = {static_cast<int32_t>(c[0]), static_cast<int32_t>(c[1]), static_cast<int32_t>(c[2])};
+        }
+    }, 4096);
+
+    for(size_t i = 0; i < count; i++){
+        if(!valid[i]){
+            throw std::runtime_error("In Spatial_hash::Voxel_downsampler: point " + std::to_string(m_num_added + i)
+                                     + " is not finite or too far for the leaf size.");
+        }
+        const Cell& cell = cells[i];
+        uint64_t slot = Grid::hash(cell) & m_table_mask;
+        while(m_table[slot] != std::numeric_limits<uint32_t>::max()){
+            const Cell& candidate = m_voxels[m_table[slot]].cell;
+            if(candidate.x == cell.x && candidate.y == cell.y && candidate.z == cell.z)
+                break;
+            slot = (slot + 1) & m_table_mask;
+        }
+        uint32_t voxel_idx = m_table[slot];
+        if(voxel_idx == std::numeric_limits<uint32_t>::max()){
+            if(m_voxels.size() + 1 >= std::numeric_limits<uint32_t>::max()){
+                throw std::runtime_error("In Spatial_hash::Voxel_downsampler: too many voxels for 32 bits indices.");
+            }
+            voxel_idx = static_cast<uint32_t>(m_voxels.size());
+            m_table[slot] = voxel_idx;
+            m_voxels.push_back({cell, 0, {0, 0, 0}, {0, 0, 0}});
+            if(2 * m_voxels.size() > m_table.size())
+                grow_table();
+        }
+        Voxel& voxel = m_voxels[voxel_idx];
+        const double* p = positions + 3 * i;
+        voxel.count++;
+        voxel.sum[0] += p[0];
+        voxel.sum[1] += p[1];
+        voxel.sum[2] += p[2];
+        voxel.color_sum[0] += colors[i].r;
+        voxel.color_sum[1] += colors[i].g;
+        voxel.color_sum[2] += colors[i].b;
+    }
+    m_num_added += count;
+}
+
+std::vector<Slam_viewer::Point> Slam_viewer::Spatial_hash::Voxel_downsampler::points() const
+{
+    if(m_leaf_size == 0)
+        return m_points;
+
+    std::vector<Point> points(m_voxels.size());
+    Parallel::parallel_for(0, m_voxels.size(), [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            const Voxel& voxel = m_voxels[i];
+            const double n = static_cast<double>(voxel.count);
+            points[i] = {static_cast<float>(voxel.sum[0] / n),
+                         static_cast<float>(voxel.sum[1] / n),
+                         static_cast<float>(voxel.sum[2] / n),
+                         {static_cast<uint8_t>((voxel.color_sum[0] + voxel.count / 2) / voxel.count),
+                          static_cast<uint8_t>((voxel.color_sum[1] + voxel.count / 2) / voxel.count),
+                          static_cast<uint8_t>((voxel.color_sum[2] + voxel.count / 2) / voxel.count)}};
+        }
+    });
+    return points;
+}
+
+void Slam_viewer::Spatial_hash::Voxel_downsampler::grow_table()
+{
+    // linear probing table at most half full, rebuilt from the voxels when it doubles
+    size_t capacity = std::max<size_t>(1024, 2 * m_table.size());
+    m_table.assign(capacity, std::numeric_limits<uint32_t>::max());
+    m_table_mask = capacity - 1;
+    for(size_t voxel_idx = 0; voxel_idx < m_voxels.size(); voxel_idx++){
+        uint64_t slot = Grid::hash(m_voxels[voxel_idx].cell) & m_table_mask;
+        while(m_table[slot] != std::numeric_limits<uint32_t>::max())
+            slot = (slot + 1) & m_table_mask;
+        m_table[slot] = static_cast<uint32_t>(voxel_idx);
+    }
+}
@@ -2,12 +2,17 @@
 #include "linalg.hpp"
 
 #include <array>
+#include <memory>
 #include <vector>
 #include <string>
 
 
 namespace Slam_viewer {
 
+namespace Writers {
+class Ply_appender;
+}
+
 //  +--------------------------------------------------------
 //  |       Relevent types for Viewer
 //  +--------------------------------------------------------
@@ -37,11 +42,114 @@ struct Triangle {
     uint32_t a, b, c;
 };
 
+struct Edge {
+    uint32_t a, b;
+};
+
 struct Point {
     float x, y, z;
     Slam_viewer::Color c;
 };
 
+//! symmetric 3x3 covariance of a position, only the upper triangle is stored
+struct Covariance {
+    float xx, xy, xz, yy, yz, zz;
+};
+
+//! similarity transform (rotation, translation and scale) applied to camera poses, see Marithmetic::transform_poses
+struct Pose_transform {
+    Quaternion rotation {0, 0, 0, 1};
+    Position translation {0, 0, 0};
+    //! scale of the positions, only used by left multiplications
+    float scale {1};
+    //! if true then the transform changes the world frame: pose = transform * pose,
+    //! otherwise it changes the camera frame: pose = pose * transform
+    bool left {true};
+    //! if true then each pose is inverted before being multiplied (world-to-camera to camera-to-world)
+    bool invert {false};
+};
+
+//! options used while loading the poses from a file
+struct Load_options {
+    //! transforms applied in order to each pose in the same pass as the loading (after the origin shift)
+    std::vector<Pose_transform> transforms;
+
+    //! if true then the positions are parsed in double precision and the origin is subtracted from them before
+    //! they are stored as floats, this keeps the precision of large coordinates (e.g. UTM positions)
+    bool shift_origin {false};
+
+    //! if true then the origin is the first position of the file, otherwise 'origin' is used
+    bool automatic_origin {true};
+    std::array<double, 3> origin {{0, 0, 0}};
+
+    //! if true then each line is a row-major 3x4 camera-to-world matrix [r00 r01 r02 x r10 r11 r12 y r20 r21 r22 z]
+    //! as in the KITTI odometry poses, the lines have no timestamp
+    bool kitti_format {false};
+};
+
+//! camera poses whose positions are relative to an origin given in double precision
+struct Trajectory {
+    std::vector<Camera_pose> poses;
+    std::array<double, 3> origin {{0, 0, 0}};
+    //! the number before the position on each line of the file (e.g. the TUM format
+    //! [timestamp p.x p.y p.z q.x q.y q.z q.w]), empty if some line has no such number
+    std::vector<double> timestamps;
+};
+
+//! bounds and steps of the camera centers, gathered while the poses are preprocessed
+struct Pose_statistics {
+    size_t num_poses {0};
+    Position min_corner {0, 0, 0};
+    Position max_corner {0, 0, 0};
+    double path_length {0};
+    float max_step {0};
+};
+
+//! a camera passing again within a radius of an earlier camera, where a loop closure is expected
+struct Revisit {
+    size_t pose;
+    size_t earlier_pose;
+    float distance;
+};
+
+//! constraint between two camera poses of a pose graph, given by their indices in the poses
+struct Graph_edge {
+    size_t from, to;
+    //! true if the poses are not neighbours in the vertex id order (a loop closure), false for odometry
+    bool loop_closure;
+};
+
+//! camera poses sorted by vertex id and the constraints between them, read from a pose graph file
+struct Pose_graph {
+    std::vector<Camera_pose> poses;
+    std::vector<size_t> vertex_ids;
+    std::vector<Graph_edge> edges;
+    //! position covariance of each pose in the world frame (null if unknown), see load_pose_graph_from_g2o_file
+    std::vector<Covariance> covariances;
+    std::array<double, 3> origin {{0, 0, 0}};
+};
+
+//! points of a map read from a file, relative to an origin given in double precision
+struct Point_cloud {
+    std::vector<Point> points;
+    std::array<double, 3> origin {{0, 0, 0}};
+    //! number of points in the file, before the voxel grid downsampling
+    size_t num_read_points {0};
+};
+
+//! named camera poses shown with their own colors and sizes next to the poses of the viewer
+struct Pose_set {
+    std::string name;
+    std::vector<Camera_pose> poses;
+    Color first_color {255, 0, 0};
+    Color last_color {0, 0, 255};
+    //! if not empty then the colors go through the palette instead of first_color -> last_color
+    std::vector<Color> palette;
+    float resize {0.04f};
+    int downsample_cameras {1};
+    int downsample_links {1};
+};
+
 
 //  +--------------------------------------------------------
 //  |       The viewer class
@@ -75,6 +183,19 @@ public:
     //! set the color of the last camera in RGB, each channel shoud be between 0 and 255
     inline void set_last_camera_color(const int r, const int g, const int b);
 
+    //! the colors of the cameras go through the palette colors from the first to the last one
+    //! (at least 2 colors), setting the first or the last camera color clears the palette
+    inline void set_colors_palette(const std::vector<Color>& palette);
+
+    //! color the cameras and links by a value per pose (e.g. the error against the ground truth) instead of by
+    //! index: the values from min_value to max_value go through a table of 256 colors from the first color to the
+    //! last one (or through the palette), values out of the range take the first or the last color and NaN values
+    //! (poses without value) are grey. If max_value is not above min_value then the largest finite value is used,
+    //! an empty vector restores the index colors
+    inline void set_cameras_values(const std::vector<float>& values, const float max_value = 0,
+                                   const float min_value = 0)
+    {m_cameras_values = values; m_max_camera_value = max_value; m_min_camera_value = min_value;}
+
     //! set how many cameras will be shown, 0 means no camera will be shown
     inline void set_cameras_downsample_factor(const int downsample)
     {m_downsample_cameras = downsample;}
@@ -85,11 +206,145 @@ public:
 
     //! each camera pose determine the orientation and the position of the camera in 3D
     inline void set_cameras_poses(const std::vector<Camera_pose>& cameras_poses)
-    {m_cameras_poses = cameras_poses;}
+    {m_cameras_poses = cameras_poses; m_correction_pending = m_use_correction;}
+
+    //! add a pose set whose geometry is saved in the same output as the poses of the viewer, the geometry
+    //! of all sets is generated in parallel and the vertices of each set follow the ones of the previous set.
+    //! The pose sets are not shown by the file grown with append_cameras_poses
+    inline void add_pose_set(const Pose_set& pose_set);
+
+    inline void clear_pose_sets()
+    {m_pose_sets.clear();}
+
+    //! rotate all camera orientations by the x->y->z euler angles in degrees (q = q * correction),
+    //! the correction is applied once to the current poses while they are preprocessed and to each appended pose
+    inline void set_correction_angles(const float rx, const float ry, const float rz);
+
+    //! the positions of the poses are relative to this origin, it is written in the header of the output files
+    inline void set_origin(const std::array<double, 3>& origin)
+    {m_origin = origin; m_has_origin = true;}
+
+    //! if radius is positive, each camera is linked to the closest earlier camera within radius whose
+    //! index is smaller by more than min_gap (see Spatial_hash::find_revisits), the revisit links are
+    //! thinner than the trajectory links and drawn with the revisit color (0 means no detection)
+    inline void set_revisit_detection(const float radius, const size_t min_gap)
+    {m_revisit_radius = radius; m_revisit_min_gap = min_gap;}
+
+    //! timestamps of the poses (one per pose, sorted, or none): with them the revisited camera should be
+    //! older by at least min_time_gap instead of min_gap poses
+    inline void set_revisit_timestamps(const std::vector<double>& timestamps, const double min_time_gap)
+    {m_revisit_timestamps = timestamps; m_revisit_min_time_gap = min_time_gap;}
+
+    //! the constraints of a pose graph are drawn as links between the camera poses (as edges in the points
+    //! and edges mode), besides the trajectory links. The indices of the edges refer to the camera poses
+    inline void set_graph_edges(const std::vector<Graph_edge>& edges)
+    {m_graph_edges = edges;}
+
+    //! set the color of the odometry graph edges in RGB, each channel shoud be between 0 and 255
+    inline void set_odometry_color(const int r, const int g, const int b)
+    {m_odometry_color = {color_bound(r), color_bound(g), color_bound(b)};}
+
+    //! set the color of the loop closure graph edges in RGB, each channel shoud be between 0 and 255
+    inline void set_loop_closure_color(const int r, const int g, const int b)
+    {m_loop_closure_color = {color_bound(r), color_bound(g), color_bound(b)};}
+
+    //! position covariance of each pose in the world frame (or none): an ellipsoid of semi-axes sigma times the
+    //! square roots of the eigenvalues is drawn at each camera kept by set_cameras_downsample_factor,
+    //! with the color of the camera. Null covariances are not drawn
+    inline void set_covariances(const std::vector<Covariance>& covariances)
+    {m_covariances = covariances;}
+
+    //! scale of the covariance ellipsoids in standard deviations (default 1)
+    inline void set_covariance_sigma(const float sigma)
+    {m_covariance_sigma = sigma;}
+
+    //! points of a map (landmarks, dense cloud...) written with the trajectory geometry: they are appended
+    //! after the vertices of the cameras and links, so they are not used by any triangle or edge
+    inline void set_map_points(const std::vector<Point>& points)
+    {m_map_points = points;}
+
+    //! set the color of the revisit links in RGB, each channel shoud be between 0 and 255
+    inline void set_revisit_color(const int r, const int g, const int b)
+    {m_revisit_color = {color_bound(r), color_bound(g), color_bound(b)};}
+
+    //! set how many revisit links will be shown, 0 means no revisit link will be shown
+    inline void set_revisits_downsample_factor(const int downsample)
+    {m_downsample_revisits = downsample;}
+
+    //! revisits found when the geometry was last generated
+    inline const std::vector<Revisit>& get_revisits() const
+    {return m_revisits;}
+
+    //! statistics of the poses gathered by the last preprocessing (when the geometry is generated)
+    inline const Pose_statistics& get_pose_statistics() const
+    {return m_pose_statistics;}
 
     //! calculate the geometry of the cameras and save the 3D to a .ply file
     inline void write_cameras_trajectory_to_ply_file(const std::string output_path);
 
+    //! calculate the geometry of the cameras and save the 3D to a file, the format is chosen
+    //! by the extension of output_path: '.obj', '.glb' or '.ply' ('.ply' is added if none is matched),
+    //! '.png' renders an image of the geometry instead, see set_render_size and set_render_view,
+    //! and '.svg' draws the path of the camera centers projected on a plane, see set_svg_plane
+    inline void write_cameras_trajectory_to_file(const std::string output_path);
+
+    //! start a binary .ply file which grows with each call to append_cameras_poses, the colors gradient
+    //! goes from the first to the last color over expected_num_poses poses (the last color is used after)
+    inline void start_ply_file(const std::string output_path, const size_t expected_num_poses);
+
+    //! add poses to the trajectory and append only their cameras and links to the file given to start_ply_file,
+    //! the file can be viewed as a point cloud between the calls
+    inline void append_cameras_poses(const std::vector<Camera_pose>& new_poses);
+
+    //! show the last camera and link and complete the file given to start_ply_file
+    inline void finalize_ply_file();
+
+    //! if true then .glb positions are stored as int16 inside the bounding box (KHR_mesh_quantization)
+    inline void set_gltf_quantization(const bool quantize)
+    {m_gltf_quantization = quantize;}
+
+    //! if true then .glb cameras are written once as a template plus one instance
+    //! (position, orientation and color) per camera (EXT_mesh_gpu_instancing)
+    inline void set_gltf_instancing(const bool instancing)
+    {m_gltf_instancing = instancing;}
+
+    //! if true then the trajectory is saved as one colored vertex per camera center linked by edges (instead of
+    //! link meshes), camera cones are only shown for the cameras kept by set_cameras_downsample_factor
+    inline void set_points_and_edges_mode(const bool points_and_edges)
+    {m_points_and_edges = points_and_edges;}
+
+    //! if true then the .ply files are binary with 15 bytes per vertex and the narrowest index type for their
+    //! vertex count (ushort up to 65536 vertices), see Writers::write_binary_ply
+    inline void set_binary_ply(const bool binary)
+    {m_binary_ply = binary;}
+
+    //! if positive, the output is split in cubic tiles of this size saved in separate files alongside a
+    //! json manifest, see Writers::write_tiles (0 means no tiling)
+    inline void set_tile_size(const float tile_size)
+    {m_tile_size = tile_size;}
+
+    //! if true then the triangles and vertices of the cameras and links are ordered for the
+    //! GPU vertex cache (Tipsify), the average cache miss ratio (ACMR) is printed in verbose mode
+    inline void set_mesh_optimization(const bool optimize)
+    {m_optimize_mesh = optimize;}
+
+    //! set the size in pixels of the '.png' and '.svg' images
+    inline void set_render_size(const size_t width, const size_t height)
+    {m_render_width = width; m_render_height = height;}
+
+    //! render the '.png' images from eye looking at target, by default the camera is placed
+    //! automatically to see the whole trajectory
+    inline void set_render_view(const linalg::vec<float, 3>& eye, const linalg::vec<float, 3>& target)
+    {m_render_eye = eye; m_render_target = target; m_render_automatic_view = false;}
+
+    //! set the plane on which the '.svg' path is projected: "xy", "xz" or "yz", the first axis
+    //! goes right and the second one goes up in the image (default "xz", a top-down view)
+    inline void set_svg_plane(const std::string plane);
+
+    //! the '.svg' path is simplified so that it moves by less than tolerance pixels (default 0.5)
+    inline void set_svg_tolerance(const float tolerance)
+    {m_svg_tolerance = tolerance;}
+
     //! if true then the class will print info message
     inline void set_verbose(const bool verbose)
     {m_verbose = verbose;}
@@ -101,6 +356,34 @@ public:
     inline static std::vector<Camera_pose>
     load_camera_poses_from_file(const std::string poses_file_path);
 
+    //! same as above, the transforms of the options are applied to blocks of poses as soon as they are read
+    inline static std::vector<Camera_pose>
+    load_camera_poses_from_file(const std::string poses_file_path, const Load_options& options);
+
+    //! same as above, the returned trajectory also gives the origin subtracted from the positions
+    inline static Trajectory
+    load_trajectory_from_file(const std::string poses_file_path, const Load_options& options);
+
+    //! get the position covariances from file, each line in the file should be on the form [... xx xy xz yy yz zz]
+    inline static std::vector<Covariance>
+    load_covariances_from_file(const std::string covariances_file_path);
+
+    //! get the vertices and edges of a .g2o pose graph file, made of the 3D records
+    //! 'VERTEX_SE3:QUAT id x y z qx qy qz qw' and 'EDGE_SE3:QUAT id1 id2 ...' (other records are skipped).
+    //! The poses are sorted by vertex id, the measurements of the edges are not used. The covariance of a
+    //! pose comes from the information matrix of the odometry edge ending at it (null if there is none)
+    inline static Pose_graph
+    load_pose_graph_from_g2o_file(const std::string g2o_file_path, const Load_options& options = Load_options());
+
+    //! get the points of a map file: text lines [x y z] or [x y z r g b] (colors between 0 and 255, lines
+    //! starting with '#' are skipped) or an ascii or binary little-endian .ply file whose vertices have the
+    //! properties x, y, z and optionally red, green, blue. The file is read in blocks streamed through a voxel
+    //! grid of side leaf_size, keeping one point per voxel (0 keeps all points), so the whole map is never in
+    //! memory. The origin shift and the world frame transforms (left ones) of the options are applied
+    inline static Point_cloud
+    load_point_cloud_from_file(const std::string cloud_file_path, const double leaf_size,
+                               const Load_options& options = Load_options());
+
 //  +--------------------------------------------------------
 //  |       The private viewer class functions
 //  +--------------------------------------------------------
@@ -113,32 +396,145 @@ private:
     std::vector<Camera_pose> m_cameras_poses;
     std::vector<Point> m_point_cloud;
     std::vector<Triangle> m_vertices;
+    std::vector<Edge> m_edges;
     Color m_first_color {255, 0, 0};
     Color m_last_color {0, 0, 255};
+    std::vector<Color> m_palette;
     std::vector<Color> m_cameras_colors;
+    std::vector<float> m_cameras_values;
+    float m_max_camera_value {0};
+    float m_min_camera_value {0};
+    Pose_statistics m_pose_statistics;
+
+    float m_revisit_radius {0};
+    size_t m_revisit_min_gap {100};
+    std::vector<double> m_revisit_timestamps;
+    double m_revisit_min_time_gap {0};
+    Color m_revisit_color {255, 0, 255};
+    int m_downsample_revisits {1};
+    std::vector<Revisit> m_revisits;
+
+    std::vector<Graph_edge> m_graph_edges;
+    Color m_odometry_color {150, 150, 150};
+    Color m_loop_closure_color {255, 140, 0};
+
+    std::vector<Covariance> m_covariances;
+    float m_covariance_sigma {1};
+
+    std::vector<Point> m_map_points;
+
+    std::vector<Pose_set> m_pose_sets;
+    // vertices range of each pose set in the composited geometry, written in the file headers
+    std::vector<std::string> m_pose_set_comments;
+
+    std::array<double, 3> m_origin {{0, 0, 0}};
+    bool m_has_origin {false};
+
+    Quaternion m_correction {0, 0, 0, 1};
+    bool m_use_correction {false};
+    bool m_correction_pending {false};
 
     float m_resize {0.04f};
     float m_resize_for_links {0.05f};
+    float m_tile_size {0};
+
+    size_t m_render_width {1024};
+    size_t m_render_height {768};
+    bool m_render_automatic_view {true};
+    linalg::vec<float, 3> m_render_eye {0, 0, 0};
+    linalg::vec<float, 3> m_render_target {0, 0, 1};
+    std::string m_svg_plane {"xz"};
+    float m_svg_tolerance {0.5f};
 
     int m_downsample_cameras {1};
     int m_downsample_links {1};
     bool m_verbose {false};
+    bool m_gltf_quantization {false};
+    bool m_gltf_instancing {false};
+    bool m_binary_ply {false};
+    bool m_points_and_edges {false};
+    bool m_optimize_mesh {false};
 
     size_t m_camera_idx {0};
     size_t m_link_idx {0};
 
+    // state of the file grown by append_cameras_poses
+    std::shared_ptr<Writers::Ply_appender> m_appender;
+    std::string m_appender_path;
+    size_t m_expected_poses {1};
+    size_t m_last_appended_camera {0};
+    size_t m_last_appended_link {0};
+
+    bool m_instance_cameras {false};
+    std::vector<size_t> m_instanced_cameras;
+
+    // glyph templates shared by all cameras and links
+    std::vector<std::array<float, 3>> m_camera_points;
+    std::vector<std::array<uint32_t, 3>> m_camera_triangles;
+    std::vector<std::array<float, 3>> m_link_points;
+    std::vector<std::array<uint32_t, 3>> m_link_triangles;
+    std::vector<std::array<float, 3>> m_sphere_points;
+    std::vector<std::array<uint32_t, 3>> m_sphere_triangles;
+    size_t m_camera_saved_misses {0};
+    size_t m_link_saved_misses {0};
+    size_t m_num_camera_glyphs {0};
+    size_t m_num_link_glyphs {0};
+
 private:
 
-    inline void normalize_quaternions();
+    inline void generate_geometry(const bool instance_cameras = false);
+
+    inline void composite_pose_sets();
+
+    inline void copy_settings(const Viewer& other);
+
+    inline void apply_pose_set(const Pose_set& pose_set);
+
+    inline void write_instanced_glb_file(const std::string output_path);
+
+    inline void write_png_file(const std::string output_path);
+
+    inline void write_svg_file(const std::string output_path);
+
+    inline void preprocess_poses();
+
+    inline void prepare_glyph_templates();
+
+    inline size_t optimize_glyph_template(std::vector<std::array<float, 3>>& points,
+                                          std::vector<std::array<uint32_t, 3>>& triangles,
+                                          const std::string name) const;
 
     inline std::vector<size_t> downsample_num_cameras(const int downsample_ratio) const;
 
     inline void make_all_cameras();
 
+    inline void make_trajectory_points_and_edges(const std::vector<size_t>& indices);
+
+    inline void make_revisit_links();
+
+    inline void make_graph_links();
+
+    inline void append_map_points();
+
+    inline void make_covariance_ellipsoids(const std::vector<size_t>& cameras_indices);
+
+    inline void make_one_standard_sphere(std::vector<std::array<float, 3>>& points,
+                                         std::vector<std::array<uint32_t, 3>>& triangles) const;
+
     inline void make_camera_geometry(const Color color,
                                      const Camera_pose pose);
 
-    inline void set_cameras_colors(const size_t size);
+    inline void make_one_standard_camera(std::vector<std::array<float, 3>>& points,
+                                         std::vector<std::array<uint32_t, 3>>& triangles) const;
+
+    inline Color gradient_color(const size_t idx, const size_t size) const;
+
+    //! the gradient sampled at 256 steps, index 255 is the last color
+    inline std::vector<Color> gradient_table() const;
+
+    inline void append_pose_geometry(const size_t idx, const bool force);
+
+    inline void flush_appended_geometry();
 
 
     inline linalg::mat<float, 3, 3> get_rotation_between_two_cam_centers(
@@ -153,10 +549,23 @@ private:
     inline void make_cameras_link(const Color color1,
                                   const Color color2,
                                   const Camera_pose & pose1,
-                                  const Camera_pose & pose2);
+                                  const Camera_pose & pose2,
+                                  const float thickness = 1);
+
+    inline void write_link_geometry(const Color color1,
+                                    const Color color2,
+                                    const Camera_pose & pose1,
+                                    const Camera_pose & pose2,
+                                    const float thickness,
+                                    Point* points_out,
+                                    Triangle* triangles_out) const;
 
     void write_data_to_file(const std::string output_path);
 
+    inline std::vector<std::string> header_comments() const;
+
+    inline static bool has_extension(const std::string& path, const std::string& extension);
+
     std::string cam_idx() const;
 
     std::string link_idx() const;
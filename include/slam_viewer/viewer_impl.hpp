@@ -2,7 +2,15 @@
 
 #include "viewer.hpp"
 #include "marithmetic.hpp"
-
+#include "writers.hpp"
+#include "mesh_optimizer.hpp"
+#include "rasterizer.hpp"
+#include "spatial_hash.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <algorithm>
 #include <fstream>
@@ -38,6 +46,7 @@ void Slam_viewer::Viewer::set_first_camera_color(const int r, const int g, const
     m_first_color.r = color_bound(r);
     m_first_color.g = color_bound(g);
     m_first_color.b = color_bound(b);
+    m_palette.clear();
 }
 
 void Slam_viewer::Viewer::set_last_camera_color(const int r, const int g, const int b)
@@ -45,6 +54,29 @@ void Slam_viewer::Viewer::set_last_camera_color(const int r, const int g, const
     m_last_color.r = color_bound(r);
     m_last_color.g = color_bound(g);
     m_last_color.b = color_bound(b);
+    m_palette.clear();
+}
+
+void Slam_viewer::Viewer::set_colors_palette(const std::vector<Color>& palette)
+{
+    if(palette.size() < 2){
+        throw std::runtime_error("In set_colors_palette: the palette should have at least 2 colors.");
+    }
+    m_palette = palette;
+    m_first_color = palette.front();
+    m_last_color = palette.back();
+}
+
+void Slam_viewer::Viewer::add_pose_set(const Pose_set& pose_set)
+{
+    if(pose_set.poses.empty()){
+        throw std::runtime_error("In add_pose_set: the pose set \"" + pose_set.name + "\" is empty.");
+    }
+    if(!pose_set.palette.empty() && pose_set.palette.size() < 2){
+        throw std::runtime_error("In add_pose_set: the palette of the pose set \"" + pose_set.name
+                                 + "\" should have at least 2 colors.");
+    }
+    m_pose_sets.push_back(pose_set);
 }
 
 
@@ -55,64 +87,691 @@ void Slam_viewer::Viewer::print_settings() const
     vcout(" - Camera resize: " + std::to_string(m_resize));
     vcout(" - Subsampling the number of cameras: " + std::to_string(m_downsample_cameras));
     vcout(" - Subsampling the number of links: " + std::to_string(m_downsample_links));
+    vcout(" - Quantized glTF positions: " + std::string(m_gltf_quantization ? "yes" : "no"));
+    vcout(" - Instanced glTF cameras: " + std::string(m_gltf_instancing ? "yes" : "no"));
+    vcout(" - Binary .ply files: " + std::string(m_binary_ply ? "yes" : "no"));
+    vcout(" - Points and edges mode: " + std::string(m_points_and_edges ? "yes" : "no"));
+    if(m_tile_size > 0)
+        vcout(" - Tile size: " + std::to_string(m_tile_size));
+    vcout(" - Vertex cache optimization: " + std::string(m_optimize_mesh ? "yes" : "no"));
+    if(m_has_origin)
+        vcout(" - Positions relative to the " + header_comments().front());
     vcout(" - First Camera color: [ r:" + std::to_string(static_cast<int>(m_first_color.r))
           + " , g:" + std::to_string(static_cast<int>(m_first_color.g))
            + " , b:" + std::to_string(static_cast<int>(m_first_color.b)) + " ]");
     vcout(" - Last Camera color: [ r:" + std::to_string(static_cast<int>(m_last_color.r))
           + " , g:" + std::to_string(static_cast<int>(m_last_color.g))
            + " , b:" + std::to_string(static_cast<int>(m_last_color.b)) + " ]");
+    if(!m_palette.empty())
+        vcout(" - Colors palette: " + std::to_string(m_palette.size()) + " colors");
+    if(!m_cameras_values.empty())
+        vcout(" - Cameras colored by value: " + std::to_string(m_cameras_values.size()) + " values");
+    if(!m_covariances.empty())
+        vcout(" - Covariance ellipsoids: " + std::to_string(m_covariance_sigma) + " sigma");
+    if(!m_graph_edges.empty())
+        vcout(" - Pose graph edges: " + std::to_string(m_graph_edges.size()));
+    if(m_revisit_radius > 0)
+        vcout(" - Revisit radius: " + std::to_string(m_revisit_radius) + ", minimal gap: "
+              + (m_revisit_timestamps.empty() ? std::to_string(m_revisit_min_gap) + " poses"
+                                              : Marithmetic::to_string_with_precision(m_revisit_min_time_gap, 4)
+                                                + " in time"));
+    if(!m_pose_sets.empty())
+        vcout(" - Pose sets: " + std::to_string(m_pose_sets.size()));
     vcout("");
 }
 
 void Slam_viewer::Viewer::write_cameras_trajectory_to_ply_file(const std::string output_path)
+{
+    this->generate_geometry();
+
+    // check if string ends with '.ply', and add it
+    std::string path = output_path;
+    if(!has_extension(path, ".ply"))
+        path += ".ply";
+
+    // save the result to output file path
+    this->write_data_to_file(path);
+    vcout("Successfully saved trajectory to: " + path);
+}
+
+void Slam_viewer::Viewer::write_cameras_trajectory_to_file(const std::string output_path)
+{
+    std::string path = output_path;
+    if(has_extension(path, ".png")){
+        this->write_png_file(path);
+        return;
+    }
+    if(has_extension(path, ".svg")){
+        this->write_svg_file(path);
+        return;
+    }
+    if(!has_extension(path, ".obj") && !has_extension(path, ".glb") && !has_extension(path, ".ply"))
+        path += ".ply";
+
+    if(m_tile_size > 0){
+        this->generate_geometry();
+        Writers::write_tiles(path, m_point_cloud, m_vertices, m_edges, m_tile_size, m_gltf_quantization,
+                             header_comments(), m_binary_ply);
+        vcout("Successfully saved trajectory tiles next to: " + path);
+        return;
+    }
+    if(has_extension(path, ".glb") && m_gltf_instancing && m_pose_sets.empty()){
+        this->write_instanced_glb_file(path);
+        return;
+    }
+
+    this->generate_geometry();
+    Writers::write_mesh_file(path, m_point_cloud, m_vertices, m_edges, m_gltf_quantization, header_comments(),
+                             m_binary_ply);
+    vcout("Successfully saved trajectory to: " + path);
+}
+
+void Slam_viewer::Viewer::write_png_file(const std::string output_path)
+{
+    this->generate_geometry();
+
+    Rasterizer::Render_settings settings;
+    settings.width = m_render_width;
+    settings.height = m_render_height;
+    settings.automatic_view = m_render_automatic_view;
+    settings.eye = m_render_eye;
+    settings.target = m_render_target;
+    std::vector<uint8_t> image = Rasterizer::render(m_point_cloud, m_vertices, m_edges, settings);
+    vcout("Rendered " + std::to_string(m_vertices.size()) + " triangles to a "
+          + std::to_string(m_render_width) + "x" + std::to_string(m_render_height) + " image");
+
+    Writers::write_png(output_path, image, m_render_width, m_render_height);
+    vcout("Successfully saved trajectory image to: " + output_path);
+}
+
+void Slam_viewer::Viewer::set_svg_plane(const std::string plane)
+{
+    if(plane != "xy" && plane != "xz" && plane != "yz"){
+        throw std::runtime_error("In set_svg_plane: the plane should be \"xy\", \"xz\" or \"yz\".");
+    }
+    m_svg_plane = plane;
+}
+
+void Slam_viewer::Viewer::write_svg_file(const std::string output_path)
+{
+    if(m_cameras_poses.empty() && m_pose_sets.empty()){
+        throw std::runtime_error("In write_svg_file: there are no camera poses to draw.");
+    }
+    if(m_render_width == 0 || m_render_height == 0){
+        throw std::runtime_error("In write_svg_file: the image size should be positive.");
+    }
+    this->print_settings();
+
+    // the poses of this viewer and the pose sets, each drawn with its own colors
+    std::vector<Viewer> painters(m_pose_sets.size());
+    std::vector<const std::vector<Camera_pose>*> layers;
+    std::vector<const Viewer*> layer_painters;
+    if(!m_cameras_poses.empty()){
+        layers.push_back(&m_cameras_poses);
+        layer_painters.push_back(this);
+    }
+    for(size_t k = 0; k < m_pose_sets.size(); k++){
+        painters[k].copy_settings(*this);
+        painters[k].apply_pose_set(m_pose_sets[k]);
+        layers.push_back(&m_pose_sets[k].poses);
+        layer_painters.push_back(&painters[k]);
+    }
+
+    // project the camera centers on the plane
+    const size_t u = m_svg_plane == "yz" ? 1 : 0;
+    const size_t v = m_svg_plane == "xy" ? 1 : 2;
+    std::vector<std::vector<linalg::vec<float, 2>>> paths(layers.size());
+    linalg::vec<float, 2> min_corner, max_corner;
+    bool first_point = true;
+    for(size_t layer = 0; layer < layers.size(); layer++){
+        const std::vector<Camera_pose>& poses = *layers[layer];
+        std::vector<linalg::vec<float, 2>>& path = paths[layer];
+        path.resize(poses.size());
+        for(size_t i = 0; i < poses.size(); i++){
+            const Position& p = poses[i].p;
+            const float coordinates[3] = {p.x, p.y, p.z};
+            path[i] = {coordinates[u], coordinates[v]};
+            if(!std::isfinite(path[i].x) || !std::isfinite(path[i].y)){
+                throw std::runtime_error("In write_svg_file: camera " + std::to_string(i) + " position is not finite.");
+            }
+            min_corner = first_point ? path[i] : linalg::min(min_corner, path[i]);
+            max_corner = first_point ? path[i] : linalg::max(max_corner, path[i]);
+            first_point = false;
+        }
+    }
+
+    // fit the paths in the image with a margin, the second axis goes up
+    const float width = static_cast<float>(m_render_width);
+    const float height = static_cast<float>(m_render_height);
+    const float margin = 0.05f * std::min(width, height);
+    const linalg::vec<float, 2> extent = max_corner - min_corner;
+    float scale = std::numeric_limits<float>::max();
+    if(extent.x > 0)
+        scale = std::min(scale, (width - 2 * margin) / extent.x);
+    if(extent.y > 0)
+        scale = std::min(scale, (height - 2 * margin) / extent.y);
+    if(scale == std::numeric_limits<float>::max())
+        scale = 1;
+    const linalg::vec<float, 2> center = (min_corner + max_corner) / 2.f;
+
+    // the start and end discs are drawn over all the paths
+    std::vector<Writers::Svg_polyline> polylines, discs;
+    for(size_t layer = 0; layer < layers.size(); layer++){
+        std::vector<linalg::vec<float, 2>>& path = paths[layer];
+        const Viewer& painter = *layer_painters[layer];
+        const size_t size = path.size();
+        for(auto& p: path)
+            p = {width / 2 + (p.x - center.x) * scale, height / 2 - (p.y - center.y) * scale};
+
+        const std::vector<size_t> kept = Marithmetic::simplify_polyline(path, m_svg_tolerance);
+        vcout("Simplified the path from " + std::to_string(size) + " to " + std::to_string(kept.size()) + " points");
+
+        // one polyline per step of the colors gradient, each segment takes the color of its first pose
+        const size_t num_steps = std::min<size_t>(64, size);
+        const size_t first = polylines.size();
+        polylines.resize(first + num_steps);
+        for(size_t k = 0; k < num_steps; k++)
+            polylines[first + k].color = painter.gradient_color(((2 * k + 1) * size) / (2 * num_steps), size);
+        for(size_t k = 1; k < kept.size(); k++){
+            Writers::Svg_polyline& polyline = polylines[first + kept[k - 1] * num_steps / size];
+            const linalg::vec<float, 2>& a = path[kept[k - 1]];
+            const linalg::vec<float, 2>& b = path[kept[k]];
+            if(polyline.points.empty())
+                polyline.points.push_back({a.x, a.y});
+            polyline.points.push_back({b.x, b.y});
+        }
+        discs.push_back({painter.m_first_color, {{path.front().x, path.front().y}}});
+        discs.push_back({painter.m_last_color, {{path.back().x, path.back().y}}});
+    }
+    polylines.insert(polylines.end(), discs.begin(), discs.end());
+
+    Writers::write_svg(output_path, m_render_width, m_render_height, polylines, 2);
+    vcout("Successfully saved trajectory path to: " + output_path);
+}
+
+void Slam_viewer::Viewer::start_ply_file(const std::string output_path, const size_t expected_num_poses)
+{
+    m_appender_path = output_path;
+    if(!has_extension(m_appender_path, ".ply"))
+        m_appender_path += ".ply";
+
+    m_appender = std::make_shared<Writers::Ply_appender>(m_appender_path, header_comments());
+    m_cameras_poses.clear();
+    m_point_cloud.clear();
+    m_vertices.clear();
+    m_edges.clear();
+    m_expected_poses = expected_num_poses == 0 ? 1 : expected_num_poses;
+    m_last_appended_camera = std::numeric_limits<size_t>::max();
+    m_last_appended_link = std::numeric_limits<size_t>::max();
+
+    this->print_settings();
+    this->prepare_glyph_templates();
+    vcout("Started growing trajectory file: " + m_appender_path);
+}
+
+void Slam_viewer::Viewer::append_cameras_poses(const std::vector<Camera_pose>& new_poses)
+{
+    if(!m_appender){
+        throw std::runtime_error("In append_cameras_poses: start_ply_file should be called first.");
+    }
+    size_t first = m_cameras_poses.size();
+    m_cameras_poses.insert(m_cameras_poses.end(), new_poses.begin(), new_poses.end());
+    for(size_t i = first; i < m_cameras_poses.size(); i++){
+        if(m_use_correction)
+            m_cameras_poses[i].q = m_cameras_poses[i].q * m_correction;
+        m_cameras_poses[i].q = Marithmetic::normalize(m_cameras_poses[i].q);
+        append_pose_geometry(i, false);
+    }
+    this->flush_appended_geometry();
+    vcout("Appended " + std::to_string(new_poses.size()) + " poses to: " + m_appender_path);
+}
+
+void Slam_viewer::Viewer::finalize_ply_file()
+{
+    if(!m_appender){
+        throw std::runtime_error("In finalize_ply_file: start_ply_file should be called first.");
+    }
+    // the last camera is always shown, like in make_all_cameras
+    if(!m_cameras_poses.empty())
+        append_pose_geometry(m_cameras_poses.size() - 1, true);
+    this->flush_appended_geometry();
+    m_appender->finalize();
+    m_appender.reset();
+    vcout("Successfully saved trajectory to: " + m_appender_path);
+}
+
+void Slam_viewer::Viewer::append_pose_geometry(const size_t idx, const bool force)
+{
+    const size_t last = m_expected_poses - 1;
+    auto color = [&](const size_t i){
+        return i >= last ? m_last_color : gradient_color(i, m_expected_poses);
+    };
+
+    m_camera_idx = idx + 1;
+    bool camera = m_downsample_cameras > 0 && (force || idx % m_downsample_cameras == 0);
+    if(camera && m_last_appended_camera != idx){
+        make_camera_geometry(color(idx), m_cameras_poses[idx]);
+        m_last_appended_camera = idx;
+    }
+
+    bool link = m_downsample_links > 0 && (force || idx % m_downsample_links == 0);
+    if(link && m_last_appended_link != idx){
+        const size_t previous = m_last_appended_link;
+        if(previous != std::numeric_limits<size_t>::max()){
+            m_link_idx = idx + 1;
+            make_cameras_link(color(previous), color(idx),
+                              m_cameras_poses[previous], m_cameras_poses[idx]);
+        }
+        m_last_appended_link = idx;
+    }
+}
+
+void Slam_viewer::Viewer::flush_appended_geometry()
+{
+    m_appender->append(m_point_cloud, m_vertices);
+    m_point_cloud.clear();
+    m_vertices.clear();
+}
+
+void Slam_viewer::Viewer::write_instanced_glb_file(const std::string output_path)
+{
+    this->generate_geometry(true);
+
+    // the template is resized here, the instances only rotate and translate it
+    std::vector<Point> camera_points;
+    std::vector<Triangle> camera_triangles;
+    for(auto& p: m_camera_points)
+        camera_points.push_back({p[0] * m_resize, p[1] * m_resize, p[2] * m_resize, {255, 255, 255}});
+    for(auto& t: m_camera_triangles)
+        camera_triangles.push_back({t[0], t[1], t[2]});
+
+    std::vector<Camera_pose> camera_poses;
+    std::vector<Color> camera_colors;
+    camera_poses.reserve(m_instanced_cameras.size());
+    camera_colors.reserve(m_instanced_cameras.size());
+    for(size_t i: m_instanced_cameras){
+        camera_poses.push_back(m_cameras_poses[i]);
+        camera_colors.push_back(m_cameras_colors[i]);
+    }
+    vcout("Instancing " + std::to_string(camera_poses.size()) + " Cameras");
+
+    Writers::write_instanced_glb(output_path, m_point_cloud, m_vertices, m_edges, m_gltf_quantization,
+                                 camera_points, camera_triangles, camera_poses, camera_colors,
+                                 header_comments());
+    vcout("Successfully saved trajectory to: " + output_path);
+}
+
+void Slam_viewer::Viewer::generate_geometry(const bool instance_cameras)
 {
     // clear used member variables
+    m_instance_cameras = instance_cameras;
+    m_instanced_cameras.clear();
     m_cameras_colors.clear();
     m_vertices.clear();
     m_point_cloud.clear();
-    m_vertices.clear();
+    m_edges.clear();
     m_camera_idx = 1;
     m_link_idx = 1;
 
+    m_num_camera_glyphs = 0;
+    m_num_link_glyphs = 0;
+    m_pose_set_comments.clear();
+    m_revisits.clear();
+
     this->print_settings();
 
     // make the cameras and links geometries
-    vcout("Normalizing quaternions");
-    this->normalize_quaternions();
+    if(!m_pose_sets.empty()){
+        this->composite_pose_sets();
+    } else {
+        vcout("Preprocessing poses");
+        this->preprocess_poses();
 
-    this->make_all_cameras();
+        this->prepare_glyph_templates();
+        this->make_all_cameras();
+        this->make_graph_links();
+        this->make_revisit_links();
+    }
+    this->append_map_points();
+
+    if(m_optimize_mesh && !m_vertices.empty()){
+        // glyphs do not share vertices, so each one misses the cache as many times as its template
+        size_t misses = Mesh_optimizer::count_cache_misses(m_vertices, m_point_cloud.size());
+        size_t misses_before = misses + m_num_camera_glyphs * m_camera_saved_misses
+                + m_num_link_glyphs * m_link_saved_misses;
+        float num_triangles = static_cast<float>(m_vertices.size());
+        vcout("Mesh ACMR: " + Marithmetic::to_string_with_precision(misses_before / num_triangles, 4)
+              + " before optimization, " + Marithmetic::to_string_with_precision(misses / num_triangles, 4)
+              + " after");
+    }
+}
 
+void Slam_viewer::Viewer::composite_pose_sets()
+{
+    // one quiet viewer per group of poses: the poses of this viewer (if any) then each pose set
+    std::vector<Viewer> parts;
+    std::vector<std::string> names;
+    const bool with_own_poses = !m_cameras_poses.empty();
+    if(with_own_poses){
+        parts.emplace_back();
+        parts.back().copy_settings(*this);
+        parts.back().m_cameras_poses.swap(m_cameras_poses);
+        parts.back().m_graph_edges = m_graph_edges;
+        parts.back().m_covariances = m_covariances;
+        parts.back().m_revisit_timestamps = m_revisit_timestamps;
+        parts.back().m_cameras_values = m_cameras_values;
+        parts.back().m_max_camera_value = m_max_camera_value;
+        parts.back().m_min_camera_value = m_min_camera_value;
+        parts.back().m_correction_pending = m_correction_pending;
+        names.push_back("main");
+    }
+    for(const Pose_set& pose_set: m_pose_sets){
+        parts.emplace_back();
+        parts.back().copy_settings(*this);
+        parts.back().apply_pose_set(pose_set);
+        parts.back().m_cameras_poses = pose_set.poses;
+        parts.back().m_correction_pending = m_use_correction;
+        names.push_back(pose_set.name);
+    }
+    vcout("Generating the geometry of " + std::to_string(parts.size()) + " pose sets");
 
+    // each part runs its own loops on one thread, see Parallel
+    std::vector<std::string> errors(parts.size());
+    Parallel::parallel_tasks(parts.size(), [&](size_t part){
+        try {
+            parts[part].generate_geometry();
+        } catch (const std::exception& e) {
+            errors[part] = e.what();
+        }
+    });
+    if(with_own_poses){
+        // the poses of this viewer are given back preprocessed
+        m_cameras_poses.swap(parts.front().m_cameras_poses);
+        m_revisits.swap(parts.front().m_revisits);
+        m_correction_pending = false;
+    }
+    for(size_t part = 0; part < parts.size(); part++){
+        if(!errors[part].empty()){
+            throw std::runtime_error("In composite_pose_sets: pose set \"" + names[part] + "\": " + errors[part]);
+        }
+    }
 
-    // check if string ends with '.ply', and add it
-    std::string path = output_path;
-    std::string extention = ".ply";
-    if(path.size() >= extention.size()){
-        if(path.compare (path.length() - extention.length(), extention.length(), extention) != 0){
-            path += extention;
+    // the elements of each part are shifted by the number of points of the previous parts
+    std::vector<size_t> point_offsets(parts.size() + 1, 0), triangle_offsets(parts.size() + 1, 0);
+    std::vector<size_t> edge_offsets(parts.size() + 1, 0), color_offsets(parts.size() + 1, 0);
+    for(size_t part = 0; part < parts.size(); part++){
+        point_offsets[part + 1] = point_offsets[part] + parts[part].m_point_cloud.size();
+        triangle_offsets[part + 1] = triangle_offsets[part] + parts[part].m_vertices.size();
+        edge_offsets[part + 1] = edge_offsets[part] + parts[part].m_edges.size();
+        color_offsets[part + 1] = color_offsets[part] + parts[part].m_cameras_colors.size();
+    }
+    if(point_offsets.back() > std::numeric_limits<uint32_t>::max()){
+        throw std::runtime_error("In composite_pose_sets: the pose sets have too many vertices for 32 bits indices.");
+    }
+    m_point_cloud.resize(point_offsets.back());
+    m_vertices.resize(triangle_offsets.back());
+    m_edges.resize(edge_offsets.back());
+    m_cameras_colors.resize(color_offsets.back());
+    Parallel::parallel_tasks(parts.size(), [&](size_t part){
+        const Viewer& source = parts[part];
+        const uint32_t bias = static_cast<uint32_t>(point_offsets[part]);
+        std::copy(source.m_point_cloud.begin(), source.m_point_cloud.end(), m_point_cloud.begin() + point_offsets[part]);
+        std::copy(source.m_cameras_colors.begin(), source.m_cameras_colors.end(),
+                  m_cameras_colors.begin() + color_offsets[part]);
+        Triangle* triangles = m_vertices.data() + triangle_offsets[part];
+        for(const Triangle& t: source.m_vertices)
+            *triangles++ = {t.a + bias, t.b + bias, t.c + bias};
+        Edge* edges = m_edges.data() + edge_offsets[part];
+        for(const Edge& e: source.m_edges)
+            *edges++ = {e.a + bias, e.b + bias};
+    });
+
+    // counters and statistics of the whole output
+    m_camera_saved_misses = parts.front().m_camera_saved_misses;
+    m_link_saved_misses = parts.front().m_link_saved_misses;
+    m_pose_statistics = Pose_statistics();
+    for(size_t part = 0; part < parts.size(); part++){
+        const Viewer& source = parts[part];
+        const Pose_statistics& statistics = source.m_pose_statistics;
+        m_num_camera_glyphs += source.m_num_camera_glyphs;
+        m_num_link_glyphs += source.m_num_link_glyphs;
+        if(part == 0){
+            m_pose_statistics = statistics;
+        } else {
+            Position& min_corner = m_pose_statistics.min_corner;
+            Position& max_corner = m_pose_statistics.max_corner;
+            min_corner = {std::min(min_corner.x, statistics.min_corner.x), std::min(min_corner.y, statistics.min_corner.y),
+                          std::min(min_corner.z, statistics.min_corner.z)};
+            max_corner = {std::max(max_corner.x, statistics.max_corner.x), std::max(max_corner.y, statistics.max_corner.y),
+                          std::max(max_corner.z, statistics.max_corner.z)};
+            m_pose_statistics.num_poses += statistics.num_poses;
+            m_pose_statistics.path_length += statistics.path_length;
+            m_pose_statistics.max_step = std::max(m_pose_statistics.max_step, statistics.max_step);
         }
-    } else {
-        path += extention;
+
+        const size_t num_vertices = point_offsets[part + 1] - point_offsets[part];
+        vcout("Pose set " + names[part] + ": " + std::to_string(statistics.num_poses) + " poses, "
+              + std::to_string(num_vertices) + " vertices, length "
+              + Marithmetic::to_string_with_precision(statistics.path_length, 6));
+        m_pose_set_comments.push_back("pose set " + names[part] + " vertices " + std::to_string(point_offsets[part])
+                                      + " " + std::to_string(num_vertices));
     }
+}
 
-    // save the result to output file path
-    this->write_data_to_file(path);
-    vcout("Successfully saved trajectory to: " + path);
+void Slam_viewer::Viewer::copy_settings(const Viewer& other)
+{
+    m_first_color = other.m_first_color;
+    m_last_color = other.m_last_color;
+    m_palette = other.m_palette;
+    m_correction = other.m_correction;
+    m_use_correction = other.m_use_correction;
+    m_resize = other.m_resize;
+    m_resize_for_links = other.m_resize_for_links;
+    m_downsample_cameras = other.m_downsample_cameras;
+    m_downsample_links = other.m_downsample_links;
+    m_points_and_edges = other.m_points_and_edges;
+    m_optimize_mesh = other.m_optimize_mesh;
+    m_revisit_radius = other.m_revisit_radius;
+    m_revisit_min_gap = other.m_revisit_min_gap;
+    m_revisit_min_time_gap = other.m_revisit_min_time_gap;
+    m_revisit_color = other.m_revisit_color;
+    m_downsample_revisits = other.m_downsample_revisits;
+    m_covariance_sigma = other.m_covariance_sigma;
+    m_odometry_color = other.m_odometry_color;
+    m_loop_closure_color = other.m_loop_closure_color;
+}
+
+void Slam_viewer::Viewer::apply_pose_set(const Pose_set& pose_set)
+{
+    m_first_color = pose_set.first_color;
+    m_last_color = pose_set.last_color;
+    m_palette.clear();
+    if(!pose_set.palette.empty())
+        set_colors_palette(pose_set.palette);
+    m_resize = pose_set.resize;
+    m_downsample_cameras = pose_set.downsample_cameras;
+    m_downsample_links = pose_set.downsample_links;
+}
+
+void Slam_viewer::Viewer::prepare_glyph_templates()
+{
+    this->make_one_standard_camera(m_camera_points, m_camera_triangles);
+    this->make_one_standard_link(m_link_points, m_link_triangles);
+    this->make_one_standard_sphere(m_sphere_points, m_sphere_triangles);
+    m_camera_saved_misses = 0;
+    m_link_saved_misses = 0;
+    if(!m_optimize_mesh)
+        return;
+
+    m_camera_saved_misses = optimize_glyph_template(m_camera_points, m_camera_triangles, "camera");
+    m_link_saved_misses = optimize_glyph_template(m_link_points, m_link_triangles, "link");
 }
 
-void Slam_viewer::Viewer::normalize_quaternions()
+size_t Slam_viewer::Viewer::optimize_glyph_template(
+        std::vector<std::array<float, 3>>& points,
+        std::vector<std::array<uint32_t, 3>>& triangles,
+        const std::string name) const
 {
-    size_t i = 0;
-    for(auto& pose: m_cameras_poses){
-        Quaternion nq = pose.q;
-        float norm = sqrtf(nq.x * nq.x + nq.y * nq.y + nq.z * nq.z + nq.w * nq.w);
-        ASSERT(std::isfinite(norm), "quaternion idx: " + std::to_string(i) );
-        nq.x /= norm;
-        nq.y /= norm;
-        nq.z /= norm;
-        nq.w /= norm;
-        pose.q = nq;
-        i++;
+    std::vector<Triangle> tris;
+    for(auto& t: triangles)
+        tris.push_back({t[0], t[1], t[2]});
+
+    size_t misses_before = Mesh_optimizer::count_cache_misses(tris, points.size());
+    tris = Mesh_optimizer::tipsify(tris, points.size());
+    std::vector<uint32_t> order = Mesh_optimizer::reorder_vertices_by_first_use(tris, points.size());
+    size_t misses_after = Mesh_optimizer::count_cache_misses(tris, points.size());
+
+    float num_triangles = static_cast<float>(tris.size());
+    vcout("ACMR of the " + name + " template: "
+          + Marithmetic::to_string_with_precision(misses_before / num_triangles, 4) + " -> "
+          + Marithmetic::to_string_with_precision(misses_after / num_triangles, 4));
+
+    // the optimized order is kept only if it is better
+    if(misses_after >= misses_before)
+        return 0;
+
+    std::vector<std::array<float, 3>> old_points = points;
+    for(size_t i = 0; i < order.size(); i++)
+        points[i] = old_points[order[i]];
+    for(size_t i = 0; i < tris.size(); i++)
+        triangles[i] = {{tris[i].a, tris[i].b, tris[i].c}};
+    return misses_before - misses_after;
+}
+
+void Slam_viewer::Viewer::set_correction_angles(const float rx, const float ry, const float rz)
+{
+    m_use_correction = std::abs(rx) + std::abs(ry) + std::abs(rz) > 10 * std::numeric_limits<float>::epsilon();
+    m_correction = Marithmetic::from_euler_in_degrees(rx, ry, rz);
+    m_correction_pending = m_use_correction;
+}
+
+void Slam_viewer::Viewer::preprocess_poses()
+{
+    // one sweep over the poses: correction, normalization, finiteness check, bounds,
+    // steps and colors are all done while a block of poses is in the cache
+    const size_t size = m_cameras_poses.size();
+    m_cameras_colors.resize(size);
+    m_pose_statistics = Pose_statistics();
+    if(size == 0)
+        return;
+
+    struct Partial {
+        linalg::vec<float, 3> min_corner, max_corner;
+        double path_length;
+        float max_step;
+        size_t first_invalid;
+    };
+    const float inf = std::numeric_limits<float>::infinity();
+    const size_t num_chunks = std::max<size_t>(1, std::min(Parallel::get_num_threads(), size / 4096));
+    std::vector<Partial> partials(num_chunks);
+    const bool correct = m_correction_pending;
+    const Quaternion correction = m_correction;
+    if(correct)
+        vcout("Applying the orientation correction to all poses");
+
+    // the colors by value are looked up in the gradient table, the index of a value is
+    // (value - min_value) * value_scale
+    const bool by_value = !m_cameras_values.empty();
+    std::vector<Color> table;
+    const float min_value = m_min_camera_value;
+    float value_scale = 0;
+    if(by_value){
+        if(m_cameras_values.size() != size){
+            throw std::runtime_error("In preprocess_poses: there are " + std::to_string(m_cameras_values.size())
+                                     + " camera values for " + std::to_string(size) + " poses.");
+        }
+        float max_value = m_max_camera_value;
+        if(max_value <= min_value){
+            max_value = min_value;
+            for(const float value: m_cameras_values){
+                if(std::isfinite(value))
+                    max_value = std::max(max_value, value);
+            }
+        }
+        table = gradient_table();
+        value_scale = max_value > min_value ? (table.size() - 1) / (max_value - min_value) : 0;
+        vcout("Coloring the cameras by value from " + Marithmetic::to_string_with_precision(min_value, 4)
+              + " to " + Marithmetic::to_string_with_precision(max_value, 4));
+    }
+    const Color no_value {128, 128, 128};
+
+    Parallel::parallel_tasks(num_chunks, [&](size_t chunk){
+        Partial partial {{inf, inf, inf}, {-inf, -inf, -inf}, 0, 0, size};
+        const size_t begin = chunk * size / num_chunks;
+        const size_t end = (chunk + 1) * size / num_chunks;
+        const size_t block_size = 256;
+        Quaternion block[block_size];
+        for(size_t first = begin; first < end; first += block_size){
+            const size_t count = std::min(block_size, end - first);
+            for(size_t k = 0; k < count; k++)
+                block[k] = m_cameras_poses[first + k].q;
+            if(correct)
+                Marithmetic::multiply(block, correction, block, count);
+            Marithmetic::normalize(block, block, count);
+
+            for(size_t k = 0; k < count; k++){
+                const size_t i = first + k;
+                Camera_pose& pose = m_cameras_poses[i];
+                pose.q = block[k];
+                if(!Marithmetic::is_finite(pose)){
+                    partial.first_invalid = std::min(partial.first_invalid, i);
+                    continue;
+                }
+                const linalg::vec<float, 3> p {pose.p.x, pose.p.y, pose.p.z};
+                partial.min_corner = linalg::min(partial.min_corner, p);
+                partial.max_corner = linalg::max(partial.max_corner, p);
+                if(i > 0){
+                    // positions are never modified by the sweep, reading the previous one is safe
+                    const Position& previous = m_cameras_poses[i - 1].p;
+                    const float step = linalg::length(p - linalg::vec<float, 3>{previous.x, previous.y, previous.z});
+                    partial.path_length += step;
+                    partial.max_step = std::max(partial.max_step, step);
+                }
+                if(by_value){
+                    // negative values take the first color, NaN fails both comparisons
+                    const float t = (m_cameras_values[i] - min_value) * value_scale;
+                    m_cameras_colors[i] = t >= 0 ? table[static_cast<size_t>(std::min(t + 0.5f, 255.f))]
+                                                 : t < 0 ? table.front() : no_value;
+                } else {
+                    m_cameras_colors[i] = gradient_color(i, size);
+                }
+            }
+        }
+        partials[chunk] = partial;
+    });
+    if(!by_value)
+        m_cameras_colors.back() = m_last_color;
+    m_correction_pending = false;
+
+    Partial total = partials[0];
+    for(size_t chunk = 1; chunk < num_chunks; chunk++){
+        total.min_corner = linalg::min(total.min_corner, partials[chunk].min_corner);
+        total.max_corner = linalg::max(total.max_corner, partials[chunk].max_corner);
+        total.path_length += partials[chunk].path_length;
+        total.max_step = std::max(total.max_step, partials[chunk].max_step);
+        total.first_invalid = std::min(total.first_invalid, partials[chunk].first_invalid);
+    }
+    if(total.first_invalid < size){
+        throw std::runtime_error("In preprocess_poses: camera pose "
+                                 + std::to_string(total.first_invalid) + " is not finite.");
+    }
+
+    m_pose_statistics.num_poses = size;
+    m_pose_statistics.min_corner = {total.min_corner.x, total.min_corner.y, total.min_corner.z};
+    m_pose_statistics.max_corner = {total.max_corner.x, total.max_corner.y, total.max_corner.z};
+    m_pose_statistics.path_length = total.path_length;
+    m_pose_statistics.max_step = total.max_step;
+
+    vcout("Trajectory bounds: [" + Marithmetic::to_string_with_precision(total.min_corner.x, 4) + ", "
+          + Marithmetic::to_string_with_precision(total.min_corner.y, 4) + ", "
+          + Marithmetic::to_string_with_precision(total.min_corner.z, 4) + "] to ["
+          + Marithmetic::to_string_with_precision(total.max_corner.x, 4) + ", "
+          + Marithmetic::to_string_with_precision(total.max_corner.y, 4) + ", "
+          + Marithmetic::to_string_with_precision(total.max_corner.z, 4) + "]");
+    if(size > 1){
+        vcout("Trajectory length: " + Marithmetic::to_string_with_precision(total.path_length, 6)
+              + ", mean step: " + Marithmetic::to_string_with_precision(total.path_length / (size - 1), 4)
+              + ", max step: " + Marithmetic::to_string_with_precision(total.max_step, 4));
     }
 }
 
@@ -144,10 +803,7 @@ void Slam_viewer::Viewer::make_all_cameras()
                                  ": cameras poses array is empty.");
     }
 
-    vcout("Calculating colors gradiants");
-    set_cameras_colors(static_cast<uint>(m_cameras_poses.size()));
-
-    ASSERT(m_cameras_colors.size() != 0, "colors array is empty");
+    ASSERT(m_cameras_colors.size() == m_cameras_poses.size(), "colors are not computed for all poses");
 
 
     std::vector<size_t> cameras_indices = downsample_num_cameras(m_downsample_cameras);
@@ -157,9 +813,13 @@ void Slam_viewer::Viewer::make_all_cameras()
 //    ASSERT(cameras_indices.size() != 0, "cameras indices array is empty");
 
     for(size_t i: cameras_indices){
-        make_camera_geometry(m_cameras_colors[i], m_cameras_poses[i]);
+        if(m_instance_cameras)
+            m_instanced_cameras.push_back(i);
+        else
+            make_camera_geometry(m_cameras_colors[i], m_cameras_poses[i]);
         m_camera_idx = i + 1;
     }
+    make_covariance_ellipsoids(cameras_indices);
 
 
     std::vector<size_t> links_indices = downsample_num_cameras(m_downsample_links);
@@ -172,6 +832,11 @@ void Slam_viewer::Viewer::make_all_cameras()
 
     ASSERT(links_indices.size() != 0, "links indices array is empty");
 
+    if(m_points_and_edges){
+        make_trajectory_points_and_edges(links_indices);
+        return ;
+    }
+
     for(size_t i = 1; i < links_indices.size(); i++){
         size_t idx_current = links_indices.at(i);
         size_t idx_previous = links_indices.at(i - 1);
@@ -185,34 +850,217 @@ void Slam_viewer::Viewer::make_all_cameras()
 
 }
 
+void Slam_viewer::Viewer::make_trajectory_points_and_edges(const std::vector<size_t>& indices)
+{
+    uint32_t bias = static_cast<uint32_t>(m_point_cloud.size());
+    m_point_cloud.reserve(m_point_cloud.size() + indices.size());
+    m_edges.reserve(m_edges.size() + indices.size() - 1);
+
+    for(size_t i = 0; i < indices.size(); i++){
+        const Camera_pose& pose = m_cameras_poses[indices[i]];
+        Point point;
+        point.x = pose.p.x;
+        point.y = pose.p.y;
+        point.z = pose.p.z;
+        point.c = m_cameras_colors[indices[i]];
+        m_point_cloud.push_back(point);
+
+        if(i > 0){
+            Edge e;
+            e.a = bias + static_cast<uint32_t>(i - 1);
+            e.b = bias + static_cast<uint32_t>(i);
+            m_edges.push_back(e);
+        }
+    }
+}
+
+void Slam_viewer::Viewer::make_graph_links()
+{
+    if(m_graph_edges.empty())
+        return;
+
+    size_t num_loop_closures = 0;
+    for(const Graph_edge& edge: m_graph_edges){
+        if(edge.from >= m_cameras_poses.size() || edge.to >= m_cameras_poses.size()){
+            throw std::runtime_error("In make_graph_links: a graph edge links the poses " + std::to_string(edge.from)
+                                     + " and " + std::to_string(edge.to) + " but there are only "
+                                     + std::to_string(m_cameras_poses.size()) + " poses.");
+        }
+        num_loop_closures += edge.loop_closure;
+    }
+    vcout("Showing " + std::to_string(m_graph_edges.size() - num_loop_closures) + " odometry and "
+          + std::to_string(num_loop_closures) + " loop closure graph edges");
+
+    // each edge has the same number of points and triangles, so the edges are written in
+    // parallel at their final place
+    const size_t size = m_graph_edges.size();
+    const size_t first_point = m_point_cloud.size();
+    if(m_points_and_edges){
+        const size_t first_edge = m_edges.size();
+        m_point_cloud.resize(first_point + 2 * size);
+        m_edges.resize(first_edge + size);
+        Parallel::parallel_for(0, size, [&](size_t begin, size_t end){
+            for(size_t k = begin; k < end; k++){
+                const Graph_edge& edge = m_graph_edges[k];
+                const Color color = edge.loop_closure ? m_loop_closure_color : m_odometry_color;
+                const Position& a = m_cameras_poses[edge.from].p;
+                const Position& b = m_cameras_poses[edge.to].p;
+                const uint32_t bias = static_cast<uint32_t>(first_point + 2 * k);
+                m_point_cloud[bias] = {a.x, a.y, a.z, color};
+                m_point_cloud[bias + 1] = {b.x, b.y, b.z, color};
+                m_edges[first_edge + k] = {bias, bias + 1};
+            }
+        });
+        return;
+    }
+
+    const size_t first_triangle = m_vertices.size();
+    const size_t num_points = m_link_points.size();
+    const size_t num_triangles = m_link_triangles.size();
+    if(first_point + size * num_points > std::numeric_limits<uint32_t>::max()){
+        throw std::runtime_error("In make_graph_links: the graph edges have too many vertices for 32 bits indices.");
+    }
+    m_point_cloud.resize(first_point + size * num_points);
+    m_vertices.resize(first_triangle + size * num_triangles);
+    Parallel::parallel_for(0, size, [&](size_t begin, size_t end){
+        for(size_t k = begin; k < end; k++){
+            const Graph_edge& edge = m_graph_edges[k];
+            const Color color = edge.loop_closure ? m_loop_closure_color : m_odometry_color;
+            write_link_geometry(color, color, m_cameras_poses[edge.from], m_cameras_poses[edge.to], 0.6f,
+                                m_point_cloud.data() + first_point + k * num_points,
+                                m_vertices.data() + first_triangle + k * num_triangles);
+        }
+    }, 1024);
+    m_num_link_glyphs += size;
+}
+
+void Slam_viewer::Viewer::append_map_points()
+{
+    if(m_map_points.empty())
+        return;
+    // the indices of the elements stay 32 bits, even for the points no element uses
+    const size_t first_point = m_point_cloud.size();
+    if(first_point + m_map_points.size() > std::numeric_limits<uint32_t>::max()){
+        throw std::runtime_error("In append_map_points: the map has too many points for 32 bits indices.");
+    }
+    vcout("Showing " + std::to_string(m_map_points.size()) + " map points");
+    m_point_cloud.resize(first_point + m_map_points.size());
+    std::copy(m_map_points.begin(), m_map_points.end(), m_point_cloud.begin() + first_point);
+}
+
+void Slam_viewer::Viewer::make_covariance_ellipsoids(const std::vector<size_t>& cameras_indices)
+{
+    if(m_covariances.empty())
+        return;
+    if(m_covariances.size() != m_cameras_poses.size()){
+        throw std::runtime_error("In make_covariance_ellipsoids: there are " + std::to_string(m_covariances.size())
+                                 + " covariances for " + std::to_string(m_cameras_poses.size()) + " poses.");
+    }
+
+    // null covariances are skipped, the others are decomposed in SIMD batches
+    std::vector<size_t> indices;
+    std::vector<Covariance> covariances;
+    for(size_t i: cameras_indices){
+        const Covariance& c = m_covariances[i];
+        if(c.xx == 0 && c.xy == 0 && c.xz == 0 && c.yy == 0 && c.yz == 0 && c.zz == 0)
+            continue;
+        indices.push_back(i);
+        covariances.push_back(c);
+    }
+    const size_t size = indices.size();
+    vcout("Showing " + std::to_string(size) + " covariance ellipsoids");
+
+    const size_t first_point = m_point_cloud.size();
+    const size_t first_triangle = m_vertices.size();
+    const size_t num_points = m_sphere_points.size();
+    const size_t num_triangles = m_sphere_triangles.size();
+    if(first_point + size * num_points > std::numeric_limits<uint32_t>::max()){
+        throw std::runtime_error("In make_covariance_ellipsoids: too many vertices for 32 bits indices.");
+    }
+    m_point_cloud.resize(first_point + size * num_points);
+    m_vertices.resize(first_triangle + size * num_triangles);
+
+    Parallel::parallel_for(0, size, [&](size_t begin, size_t end){
+        std::vector<linalg::vec<float, 3>> eigenvalues(end - begin);
+        std::vector<linalg::mat<float, 3, 3>> eigenvectors(end - begin);
+        Marithmetic::eigen_symmetric3(covariances.data() + begin, eigenvalues.data(), eigenvectors.data(), end - begin);
+
+        for(size_t k = begin; k < end; k++){
+            // the unit sphere is scaled along the eigenvectors, a right-handed basis keeps the triangles outward
+            linalg::mat<float, 3, 3> axes = eigenvectors[k - begin];
+            if(linalg::determinant(axes) < 0)
+                axes[2] = -axes[2];
+            const linalg::vec<float, 3> lambda = linalg::max(eigenvalues[k - begin], linalg::vec<float, 3>(0, 0, 0));
+            for(int j = 0; j < 3; j++)
+                axes[j] *= m_covariance_sigma * std::sqrt(lambda[j]);
+
+            const Camera_pose& pose = m_cameras_poses[indices[k]];
+            const linalg::vec<float, 3> center {pose.p.x, pose.p.y, pose.p.z};
+            const Color color = m_cameras_colors[indices[k]];
+            const uint32_t bias = static_cast<uint32_t>(first_point + k * num_points);
+            Point* points = m_point_cloud.data() + bias;
+            for(const std::array<float, 3>& u: m_sphere_points){
+                const linalg::vec<float, 3> p = center + linalg::mul(axes, linalg::vec<float, 3>(u[0], u[1], u[2]));
+                *points++ = {p.x, p.y, p.z, color};
+            }
+            Triangle* triangles = m_vertices.data() + first_triangle + k * num_triangles;
+            for(const std::array<uint32_t, 3>& t: m_sphere_triangles)
+                *triangles++ = {t[0] + bias, t[1] + bias, t[2] + bias};
+        }
+    }, 256);
+}
+
+void Slam_viewer::Viewer::make_revisit_links()
+{
+    if(m_revisit_radius <= 0)
+        return;
+
+    m_revisits = Spatial_hash::find_revisits(m_cameras_poses, m_revisit_radius, m_revisit_min_gap,
+                                             m_revisit_timestamps, m_revisit_min_time_gap);
+    vcout("Found " + std::to_string(m_revisits.size()) + " revisits within "
+          + Marithmetic::to_string_with_precision(m_revisit_radius, 4) + " (minimal gap of "
+          + (m_revisit_timestamps.empty() ? std::to_string(m_revisit_min_gap) + " poses)"
+             : Marithmetic::to_string_with_precision(m_revisit_min_time_gap, 4) + " in time)"));
+    if(m_downsample_revisits <= 0)
+        return;
+
+    size_t num_links = 0;
+    for(size_t k = 0; k < m_revisits.size(); k += m_downsample_revisits){
+        const Camera_pose& pose = m_cameras_poses[m_revisits[k].pose];
+        const Camera_pose& earlier_pose = m_cameras_poses[m_revisits[k].earlier_pose];
+        if(m_points_and_edges){
+            const uint32_t bias = static_cast<uint32_t>(m_point_cloud.size());
+            m_point_cloud.push_back({earlier_pose.p.x, earlier_pose.p.y, earlier_pose.p.z, m_revisit_color});
+            m_point_cloud.push_back({pose.p.x, pose.p.y, pose.p.z, m_revisit_color});
+            m_edges.push_back({bias, bias + 1});
+        } else {
+            make_cameras_link(m_revisit_color, m_revisit_color, earlier_pose, pose, 0.4f);
+        }
+        num_links++;
+    }
+    vcout("Showing " + std::to_string(num_links) + "/" + std::to_string(m_revisits.size()) + " Revisit links");
+}
+
 void Slam_viewer::Viewer::make_camera_geometry(
         const Color color,
         const Camera_pose pose)
 {
-    size_t bias = m_point_cloud.size();
+    uint32_t bias = static_cast<uint32_t>(m_point_cloud.size());
     linalg::mat<float, 4, 4> pose_m4 = Marithmetic::to_pose_matrix4(pose);
 
     ASSERT(Marithmetic::is_pose_matrix(pose_m4), cam_idx());
 
 //    Marithmetic::printm(pose_m4, 4, 4, "pose");
     // initial camera vertices positions
-    std::vector<linalg::vec<float, 4>> points;
-    points = {{0, 0, 0, 1}, {0.75, 0.5, 1, 1}, {-0.75, 0.5, 1, 1},
-              {-0.75, -0.5, 1, 1}, {0.75, -0.5, 1, 1},
-              {-0.2f, -0.5, 1, 1} , {0.2f, -0.5f, 1, 1}, {0, -0.7f, 1, 1},
-              {0, 0, 0.5f, 1}};
+    const std::vector<std::array<float, 3>>& points = m_camera_points;
+    const std::vector<std::array<uint32_t, 3>>& triangles = m_camera_triangles;
 
-    std::vector<Triangle> triangles;
-    triangles = {{0, 2, 1}, {0, 1, 4}, {0, 4, 3},
-                 {0, 3, 2}, {2, 3, 4}, {1, 2, 4},
-                 {6, 5, 7}, {7, 5, 8}, {6, 7, 8}};
-
-    for(uint i = 0; i < 9; i++){
+    for(uint i = 0; i < points.size(); i++){
         Point tmp_point;
         tmp_point.c = color;
 
         // applay camera transformation after resize
-        linalg::vec<float, 4> position = points.at(i);
+        linalg::vec<float, 4> position = {points.at(i).at(0), points.at(i).at(1), points.at(i).at(2), 1};
         for(size_t j = 0; j < 3; j++)
             position[j] *= m_resize;
 
@@ -230,31 +1078,62 @@ void Slam_viewer::Viewer::make_camera_geometry(
     }
 
 
-    for (auto & t : triangles ){
-        t.a += bias;
-        t.b += bias;
-        t.c += bias;
+    for (auto & triangle : triangles ){
+        Triangle t;
+        t.a = triangle[0] + bias;
+        t.b = triangle[1] + bias;
+        t.c = triangle[2] + bias;
 
         m_vertices.push_back(t);
     }
+    m_num_camera_glyphs++;
+}
+
+void Slam_viewer::Viewer::make_one_standard_camera(
+        std::vector<std::array<float, 3>>& points,
+        std::vector<std::array<uint32_t, 3>>& triangles) const
+{
+    points = {{0, 0, 0}, {0.75, 0.5, 1}, {-0.75, 0.5, 1},
+              {-0.75, -0.5, 1}, {0.75, -0.5, 1},
+              {-0.2f, -0.5, 1} , {0.2f, -0.5f, 1}, {0, -0.7f, 1},
+              {0, 0, 0.5f}};
+
+    triangles = {{0, 2, 1}, {0, 1, 4}, {0, 4, 3},
+                 {0, 3, 2}, {2, 3, 4}, {1, 2, 4},
+                 {6, 5, 7}, {7, 5, 8}, {6, 7, 8}};
 }
 
-void Slam_viewer::Viewer::set_cameras_colors(const size_t size)
+Slam_viewer::Color Slam_viewer::Viewer::gradient_color(const size_t idx, const size_t size) const
 {
-    m_cameras_colors.reserve(size);
+    Color tmp_color;
     float sizef = static_cast<float>(size);
-    // color interpolation
-    for (uint i = 0; i < size; i++) {
-        Color tmp_color;
-        float idx = static_cast<float>(i);
-        tmp_color.r = static_cast<uint8_t>(m_first_color.r - (m_first_color.r - m_last_color.r) * idx / sizef);
-        tmp_color.g = static_cast<uint8_t>(m_first_color.g - (m_first_color.g - m_last_color.g) * idx / sizef);
-        tmp_color.b = static_cast<uint8_t>(m_first_color.b - (m_first_color.b - m_last_color.b) * idx / sizef);
-        m_cameras_colors.push_back(tmp_color);
+    float idxf = static_cast<float>(idx);
+    if(!m_palette.empty()){
+        // piecewise linear through the palette colors
+        const float t = idxf / sizef * (m_palette.size() - 1);
+        const size_t k = std::min(static_cast<size_t>(t), m_palette.size() - 2);
+        const float f = t - k;
+        const Color& a = m_palette[k];
+        const Color& b = m_palette[k + 1];
+        tmp_color.r = static_cast<uint8_t>(a.r - (a.r - b.r) * f);
+        tmp_color.g = static_cast<uint8_t>(a.g - (a.g - b.g) * f);
+        tmp_color.b = static_cast<uint8_t>(a.b - (a.b - b.b) * f);
+        return tmp_color;
     }
-    m_cameras_colors.back() = m_last_color;
+    tmp_color.r = static_cast<uint8_t>(m_first_color.r - (m_first_color.r - m_last_color.r) * idxf / sizef);
+    tmp_color.g = static_cast<uint8_t>(m_first_color.g - (m_first_color.g - m_last_color.g) * idxf / sizef);
+    tmp_color.b = static_cast<uint8_t>(m_first_color.b - (m_first_color.b - m_last_color.b) * idxf / sizef);
+    return tmp_color;
 }
 
+std::vector<Slam_viewer::Color> Slam_viewer::Viewer::gradient_table() const
+{
+    std::vector<Color> table(256);
+    for(size_t k = 0; k + 1 < table.size(); k++)
+        table[k] = gradient_color(k, table.size() - 1);
+    table.back() = m_last_color;
+    return table;
+}
 
 Slam_viewer::linalg::mat<float, 3, 3> Slam_viewer::Viewer::get_rotation_between_two_cam_centers(
         const linalg::vec<float, 3>& cam1,
@@ -266,12 +1145,18 @@ Slam_viewer::linalg::mat<float, 3, 3> Slam_viewer::Viewer::get_rotation_between_
     ASSERT(Marithmetic::is_float3_vector(cam2), link_idx());
 
     linalg::vec<float, 3> An = cam2 - cam1;
+    // coincident centers (e.g. a loop closure to the same place) give a link of null length
+    if(linalg::length2(An) == 0)
+        return rot;
     An = linalg::normalize(An);
     ASSERT(Marithmetic::is_float3_vector(An), link_idx());
 
     float eps = 10 * std::numeric_limits<float>::epsilon();
     if(fabs(An[0]) <= eps && fabs(An[1])  <= eps && fabs(An[2] - 1)  <= eps)
         return rot;
+    // opposite to the z-axis: half turn around the x-axis
+    if(fabs(An[0]) <= eps && fabs(An[1])  <= eps && fabs(An[2] + 1)  <= eps)
+        return {{1, 0, 0}, {0, -1, 0}, {0, 0, -1}};
 
 
     linalg::vec<float, 3> Bn {0, 0, 1};
@@ -295,6 +1180,45 @@ Slam_viewer::linalg::mat<float, 3, 3> Slam_viewer::Viewer::get_rotation_between_
 }
 
 
+void Slam_viewer::Viewer::make_one_standard_sphere(
+        std::vector<std::array<float, 3>>& points,
+        std::vector<std::array<uint32_t, 3>>& triangles) const
+{
+    // icosahedron with each triangle split in 4, the new points are pushed back on the unit sphere
+    const float t = 1.618034f;  // golden ratio
+    points = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+              {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+              {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    std::vector<std::array<uint32_t, 3>> faces = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+                                                  {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                                                  {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+                                                  {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+
+    std::vector<std::array<uint32_t, 3>> middles;  // (first point, second point, middle point)
+    auto middle = [&](const uint32_t a, const uint32_t b){
+        for(auto& m: middles)
+            if((m[0] == a && m[1] == b) || (m[0] == b && m[1] == a))
+                return m[2];
+        const uint32_t idx = static_cast<uint32_t>(points.size());
+        points.push_back({(points[a][0] + points[b][0]) / 2, (points[a][1] + points[b][1]) / 2,
+                          (points[a][2] + points[b][2]) / 2});
+        middles.push_back({{a, b, idx}});
+        return idx;
+    };
+    triangles.clear();
+    for(auto& f: faces){
+        const uint32_t ab = middle(f[0], f[1]), bc = middle(f[1], f[2]), ca = middle(f[2], f[0]);
+        triangles.push_back({{f[0], ab, ca}});
+        triangles.push_back({{f[1], bc, ab}});
+        triangles.push_back({{f[2], ca, bc}});
+        triangles.push_back({{ab, bc, ca}});
+    }
+    for(auto& p: points){
+        const float norm = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        p = {{p[0] / norm, p[1] / norm, p[2] / norm}};
+    }
+}
+
 void Slam_viewer::Viewer::make_one_standard_link(
         std::vector<std::array<float, 3>>& points,
         std::vector<std::array<uint32_t, 3>>& triangles) const
@@ -338,15 +1262,31 @@ void Slam_viewer::Viewer::make_cameras_link(
         const Color color1,
         const Color color2,
         const Camera_pose & pose1,
-        const Camera_pose & pose2)
+        const Camera_pose & pose2,
+        const float thickness)
 {
-    uint32_t bias = static_cast<uint32_t>(m_point_cloud.size());
+    const size_t first_point = m_point_cloud.size();
+    const size_t first_triangle = m_vertices.size();
+    m_point_cloud.resize(first_point + m_link_points.size());
+    m_vertices.resize(first_triangle + m_link_triangles.size());
+    write_link_geometry(color1, color2, pose1, pose2, thickness,
+                        m_point_cloud.data() + first_point, m_vertices.data() + first_triangle);
+    m_num_link_glyphs++;
+}
 
-    std::vector<std::array<float, 3>> points;
-    std::vector<std::array<uint32_t, 3>> triangles;
-    this->make_one_standard_link(points, triangles);
+void Slam_viewer::Viewer::write_link_geometry(
+        const Color color1,
+        const Color color2,
+        const Camera_pose & pose1,
+        const Camera_pose & pose2,
+        const float thickness,
+        Point* points_out,
+        Triangle* triangles_out) const
+{
+    uint32_t bias = static_cast<uint32_t>(points_out - m_point_cloud.data());
 
-    const uint num_points = 26;
+    const std::vector<std::array<float, 3>>& points = m_link_points;
+    const std::vector<std::array<uint32_t, 3>>& triangles = m_link_triangles;
 
     linalg::mat<float, 4, 4> pose1_m4 = Marithmetic::to_pose_matrix4(pose1);
     linalg::mat<float, 4, 4> pose2_m4 = Marithmetic::to_pose_matrix4(pose2);
@@ -362,12 +1302,13 @@ void Slam_viewer::Viewer::make_cameras_link(
 
     linalg::mat<float, 3, 3> rot = this->get_rotation_between_two_cam_centers(cam1m, cam2m);
 
-    float r = m_resize_for_links * m_resize; // ratio
-    for(uint i = 0; i < num_points; i++){
-        // decide according to link first or second part
-        linalg::vec<float, 4> cam = (i < num_points / 2) ? cam1: cam2;
-        Color color = (i < num_points / 2) ? color1: color2;
-        float bias = (i < num_points / 2) ? 0: 20;
+    float r = m_resize_for_links * m_resize * thickness; // ratio
+    for(uint i = 0; i < points.size(); i++){
+        // decide according to link first or second part (the second part is around z = 20)
+        bool first_part = points.at(i).at(2) < 10;
+        linalg::vec<float, 4> cam = first_part ? cam1: cam2;
+        Color color = first_part ? color1: color2;
+        float bias = first_part ? 0: 20;
 
         // load point
         Point point;
@@ -379,7 +1320,7 @@ void Slam_viewer::Viewer::make_cameras_link(
         point.x = r * pp[0] + cam[0];
         point.y = r * pp[1] + cam[1];
         point.z = r * pp[2] + cam[2];
-        m_point_cloud.push_back(point);
+        *points_out++ = point;
     }
 
     for (auto & triangle : triangles ){
@@ -387,51 +1328,69 @@ void Slam_viewer::Viewer::make_cameras_link(
         v.a = triangle[0] + bias;
         v.b = triangle[1] + bias;
         v.c = triangle[2] + bias;
-        m_vertices.push_back(v);
+        *triangles_out++ = v;
     }
 }
 
 void Slam_viewer::Viewer::write_data_to_file(const std::string output_path)
 {
-    std::ofstream strm(output_path);
-     if(!strm){
-         throw std::runtime_error("In write_data_to_file: unable to open file under: " + output_path + ".");
-     }
-     strm << "ply\n";
-     strm << "format ascii 1.0\n";
-     strm << "comment Slam Viewer generated\n";
-     strm << "element vertex " << m_point_cloud.size()<< "\n";
-     strm << "property float x\n";
-     strm << "property float y\n";
-     strm << "property float z\n";
-     strm << "property uchar red\n";
-     strm << "property uchar green\n";
-     strm << "property uchar blue\n";
-     strm << "element face " << m_vertices.size() <<"\n";
-     strm << "property list uchar int vertex_indices\n";
-     strm << "end_header\n";
-     for(auto& p: m_point_cloud)
-         strm << p.x << " " << p.y << " " << p.z << " "
-              << static_cast<int>(p.c.r) << " " << static_cast<int>(p.c.g)
-              << " " << static_cast<int>(p.c.b) << "\n";
-
-     for(auto& t: m_vertices)
-         strm << "3 " <<  t.a << " " << t.b << " "  << t.c << "\n";
-
-     strm.close();
+    if(m_binary_ply)
+        Writers::write_binary_ply(output_path, m_point_cloud, m_vertices, m_edges, header_comments());
+    else
+        Writers::write_ply(output_path, m_point_cloud, m_vertices, m_edges, header_comments());
+}
 
+std::vector<std::string> Slam_viewer::Viewer::header_comments() const
+{
+    std::vector<std::string> comments;
+    if(m_has_origin){
+        // 17 significant digits give back the exact double
+        char origin[96];
+        std::snprintf(origin, sizeof(origin), "origin %.17g %.17g %.17g", m_origin[0], m_origin[1], m_origin[2]);
+        comments.push_back(origin);
+    }
+    comments.insert(comments.end(), m_pose_set_comments.begin(), m_pose_set_comments.end());
+    return comments;
 }
 
 std::vector<Slam_viewer::Camera_pose>
 Slam_viewer::Viewer::load_camera_poses_from_file(const std::string poses_file_path)
 {
+    return load_camera_poses_from_file(poses_file_path, Load_options());
+}
+
+std::vector<Slam_viewer::Camera_pose>
+Slam_viewer::Viewer::load_camera_poses_from_file(const std::string poses_file_path, const Load_options& options)
+{
+    return load_trajectory_from_file(poses_file_path, options).poses;
+}
+
+Slam_viewer::Trajectory
+Slam_viewer::Viewer::load_trajectory_from_file(const std::string poses_file_path, const Load_options& options)
+{
+    Trajectory trajectory;
+    std::vector<Camera_pose>& poses = trajectory.poses;
+    std::array<double, 3>& origin = trajectory.origin;
+    if(options.shift_origin && !options.automatic_origin)
+        origin = options.origin;
+
+    // the transforms are applied to each block of poses while it is still in the cache
+    const size_t block_size = 256;
+    size_t num_transformed = 0;
+    auto transform_block = [&](std::vector<Camera_pose>& poses){
+        for(const Pose_transform& transform: options.transforms)
+            Marithmetic::transform_poses(poses.data() + num_transformed, poses.data() + num_transformed,
+                                         poses.size() - num_transformed, transform);
+        num_transformed = poses.size();
+    };
+
     std::ifstream strm(poses_file_path);
     if(!strm){
         throw std::runtime_error("In load_poses_from_file: unable to open file under: " + poses_file_path + ".");
     }
-    std::vector<Camera_pose> poses;
     std::string line;
     size_t lidx = 1;
+    bool has_timestamps = true;
     while(std::getline(strm, line)){
 
         std::istringstream iss(line);
@@ -439,6 +1398,11 @@ Slam_viewer::Viewer::load_camera_poses_from_file(const std::string poses_file_pa
             std::istream_iterator<std::string>(iss), {}
         };
         size_t length = words.size();
+        if(options.kitti_format && length != 12){
+            throw std::runtime_error("In load_poses_from_file: file line num '" + std::to_string(lidx)
+                                     + "' has " + std::to_string(length) + " words instead of 12. It should be "
+                                     "on the form: [r00 r01 r02 p.x r10 r11 r12 p.y r20 r21 r22 p.z].");
+        }
         if(length < 7){
             throw std::runtime_error("In load_poses_from_file: file line num '"
                                      + std::to_string(lidx)
@@ -447,17 +1411,44 @@ Slam_viewer::Viewer::load_camera_poses_from_file(const std::string poses_file_pa
 
         }
 
+        // indices of the position words, the KITTI positions are the last column of the matrix
         uint bias = static_cast<uint>(length - 7);
+        const size_t position_words[3] = {options.kitti_format ? 3 : bias + 0u,
+                                          options.kitti_format ? 7 : bias + 1u,
+                                          options.kitti_format ? 11 : bias + 2u};
         Camera_pose pose;
         try {
-            pose.q.x = std::stof(words.at(bias + 3));
-            pose.q.y = std::stof(words.at(bias + 4));
-            pose.q.z = std::stof(words.at(bias + 5));
-            pose.q.w = std::stof(words.at(bias + 6));
-
-            pose.p.x = std::stof(words.at(bias + 0));
-            pose.p.y = std::stof(words.at(bias + 1));
-            pose.p.z = std::stof(words.at(bias + 2));
+            if(options.kitti_format){
+                linalg::mat<double, 3, 3> rotation;
+                for(size_t row = 0; row < 3; row++){
+                    for(size_t col = 0; col < 3; col++)
+                        rotation[col][row] = std::stod(words.at(4 * row + col));
+                }
+                const linalg::vec<double, 4> q = linalg::rotation_quat(rotation);
+                pose.q = {static_cast<float>(q.x), static_cast<float>(q.y),
+                          static_cast<float>(q.z), static_cast<float>(q.w)};
+            } else {
+                pose.q.x = std::stof(words.at(bias + 3));
+                pose.q.y = std::stof(words.at(bias + 4));
+                pose.q.z = std::stof(words.at(bias + 5));
+                pose.q.w = std::stof(words.at(bias + 6));
+            }
+
+            if(options.shift_origin){
+                // the difference is computed in double, only the small result is narrowed to float
+                const double position[3] = {std::stod(words.at(position_words[0])),
+                                            std::stod(words.at(position_words[1])),
+                                            std::stod(words.at(position_words[2]))};
+                if(options.automatic_origin && poses.empty())
+                    origin = {{position[0], position[1], position[2]}};
+                pose.p.x = static_cast<float>(position[0] - origin[0]);
+                pose.p.y = static_cast<float>(position[1] - origin[1]);
+                pose.p.z = static_cast<float>(position[2] - origin[2]);
+            } else {
+                pose.p.x = std::stof(words.at(position_words[0]));
+                pose.p.y = std::stof(words.at(position_words[1]));
+                pose.p.z = std::stof(words.at(position_words[2]));
+            }
         } catch (const std::invalid_argument& ia) {
             throw std::runtime_error("In load_poses_from_file: file line num '" + std::to_string(lidx) +
                                      "'. error using " + ia.what() + "."
@@ -465,13 +1456,620 @@ Slam_viewer::Viewer::load_camera_poses_from_file(const std::string poses_file_pa
         }
 
 
+        // the timestamps are kept only if every line has one
+        if(has_timestamps && bias > 0 && !options.kitti_format){
+            const char* word = words[bias - 1].c_str();
+            char* end;
+            const double timestamp = std::strtod(word, &end);
+            has_timestamps = end != word && *end == '\0';
+            trajectory.timestamps.push_back(timestamp);
+        } else {
+            has_timestamps = false;
+        }
+
         poses.push_back(pose);
+        if(poses.size() - num_transformed == block_size)
+            transform_block(poses);
         lidx++;
     }
     strm.close();
-    return poses;
+    transform_block(poses);
+    if(!has_timestamps)
+        trajectory.timestamps.clear();
+    return trajectory;
+}
+
+std::vector<Slam_viewer::Covariance>
+Slam_viewer::Viewer::load_covariances_from_file(const std::string covariances_file_path)
+{
+    std::ifstream strm(covariances_file_path);
+    if(!strm){
+        throw std::runtime_error("In load_covariances_from_file: unable to open file under: "
+                                 + covariances_file_path + ".");
+    }
+    std::vector<Covariance> covariances;
+    std::string line;
+    size_t lidx = 1;
+    while(std::getline(strm, line)){
+        // all numbers of the line are read, the last 6 ones are kept
+        std::vector<float> numbers;
+        const char* c = line.c_str();
+        for(;;){
+            char* next;
+            const float value = std::strtof(c, &next);
+            if(next == c)
+                break;
+            numbers.push_back(value);
+            c = next;
+        }
+        if(numbers.size() < 6){
+            throw std::runtime_error("In load_covariances_from_file: file line num '" + std::to_string(lidx)
+                                     + "' has less than 6 numbers. It should be on the form: "
+                                     "[... xx xy xz yy yz zz].");
+        }
+        const float* v = numbers.data() + numbers.size() - 6;
+        covariances.push_back({v[0], v[1], v[2], v[3], v[4], v[5]});
+        lidx++;
+    }
+    return covariances;
 }
 
+Slam_viewer::Pose_graph
+Slam_viewer::Viewer::load_pose_graph_from_g2o_file(const std::string g2o_file_path, const Load_options& options)
+{
+    std::ifstream strm(g2o_file_path);
+    if(!strm){
+        throw std::runtime_error("In load_pose_graph_from_g2o_file: unable to open file under: " + g2o_file_path + ".");
+    }
+
+    // the numbers are read with strtod, much faster than streams for large graphs
+    struct Vertex {
+        size_t id;
+        double p[3];
+        Quaternion q;
+    };
+    std::vector<Vertex> vertices;
+    std::vector<std::array<size_t, 2>> edge_ids;
+    std::vector<Covariance> edge_covariances;  // in the frame of the first vertex of the edge
+    std::string line;
+    size_t lidx = 0;
+    auto parse_error = [&](const std::string& message){
+        return std::runtime_error("In load_pose_graph_from_g2o_file: file line num '" + std::to_string(lidx)
+                                  + "': " + message);
+    };
+    while(std::getline(strm, line)){
+        lidx++;
+        const char* c = line.c_str();
+        while(*c == ' ' || *c == '\t')
+            c++;
+        const char* tag_end = c;
+        while(*tag_end && *tag_end != ' ' && *tag_end != '\t')
+            tag_end++;
+        const std::string tag(c, tag_end);
+        const bool is_vertex = tag == "VERTEX_SE3:QUAT";
+        if(!is_vertex && tag != "EDGE_SE3:QUAT")
+            continue;
+
+        // ids then the position and the orientation of the vertex (the measurement of the edge is skipped)
+        const size_t num_ids = is_vertex ? 1 : 2;
+        size_t ids[2];
+        for(size_t k = 0; k < num_ids; k++){
+            char* next;
+            const long long id = std::strtoll(tag_end, &next, 10);
+            if(next == tag_end || id < 0)
+                throw parse_error("wrong vertex id.");
+            ids[k] = static_cast<size_t>(id);
+            tag_end = next;
+        }
+        if(!is_vertex){
+            // 7 measurement numbers then the upper triangle of the 6x6 information matrix (position then
+            // rotation), the position covariance is the top-left 3x3 block of its inverse, marginal over the
+            // rotation (null if missing or if the information matrix is not positive definite)
+            double numbers[28];
+            size_t num_numbers = 0;
+            for(; num_numbers < 28; num_numbers++){
+                char* next;
+                numbers[num_numbers] = std::strtod(tag_end, &next);
+                if(next == tag_end)
+                    break;
+                tag_end = next;
+            }
+            Covariance covariance {0, 0, 0, 0, 0, 0};
+            if(num_numbers == 28){
+                double l[6][6];
+                for(size_t r = 0, k = 7; r < 6; r++)
+                    for(size_t c = r; c < 6; c++, k++)
+                        l[r][c] = l[c][r] = numbers[k];
+                // Cholesky factorization information = L L^T in the lower triangle, a pivot that is
+                // not positive (or NaN) means the matrix is not positive definite
+                bool positive_definite = true;
+                for(size_t j = 0; j < 6 && positive_definite; j++){
+                    for(size_t k = 0; k < j; k++)
+                        l[j][j] -= l[j][k] * l[j][k];
+                    positive_definite = l[j][j] > 0;
+                    l[j][j] = std::sqrt(l[j][j]);
+                    for(size_t i = j + 1; i < 6; i++){
+                        for(size_t k = 0; k < j; k++)
+                            l[i][j] -= l[i][k] * l[j][k];
+                        l[i][j] /= l[j][j];
+                    }
+                }
+                if(positive_definite){
+                    // the first 3 columns of the inverse, solving L L^T x = e_c
+                    double x[3][6];
+                    for(size_t c = 0; c < 3; c++){
+                        for(size_t i = 0; i < 6; i++){
+                            x[c][i] = i == c ? 1 : 0;
+                            for(size_t k = 0; k < i; k++)
+                                x[c][i] -= l[i][k] * x[c][k];
+                            x[c][i] /= l[i][i];
+                        }
+                        for(size_t i = 6; i-- > 0;){
+                            for(size_t k = i + 1; k < 6; k++)
+                                x[c][i] -= l[k][i] * x[c][k];
+                            x[c][i] /= l[i][i];
+                        }
+                    }
+                    covariance = {float(x[0][0]), float(x[0][1]), float(x[0][2]),
+                                  float(x[1][1]), float(x[1][2]), float(x[2][2])};
+                }
+            }
+            edge_ids.push_back({{ids[0], ids[1]}});
+            edge_covariances.push_back(covariance);
+            continue;
+        }
+        double numbers[7];
+        for(size_t k = 0; k < 7; k++){
+            char* next;
+            numbers[k] = std::strtod(tag_end, &next);
+            if(next == tag_end)
+                throw parse_error("a vertex should be on the form: VERTEX_SE3:QUAT id x y z qx qy qz qw.");
+            tag_end = next;
+        }
+        Vertex vertex;
+        vertex.id = ids[0];
+        vertex.p[0] = numbers[0];
+        vertex.p[1] = numbers[1];
+        vertex.p[2] = numbers[2];
+        vertex.q = {static_cast<float>(numbers[3]), static_cast<float>(numbers[4]),
+                    static_cast<float>(numbers[5]), static_cast<float>(numbers[6])};
+        vertices.push_back(vertex);
+    }
+    strm.close();
+
+    std::sort(vertices.begin(), vertices.end(), [](const Vertex& a, const Vertex& b){return a.id < b.id;});
+    for(size_t i = 1; i < vertices.size(); i++){
+        if(vertices[i].id == vertices[i - 1].id){
+            throw std::runtime_error("In load_pose_graph_from_g2o_file: the vertex id "
+                                     + std::to_string(vertices[i].id) + " is used twice.");
+        }
+    }
+
+    Pose_graph graph;
+    if(options.shift_origin){
+        if(!options.automatic_origin)
+            graph.origin = options.origin;
+        else if(!vertices.empty())
+            graph.origin = {{vertices[0].p[0], vertices[0].p[1], vertices[0].p[2]}};
+    }
+    graph.poses.resize(vertices.size());
+    graph.vertex_ids.resize(vertices.size());
+    for(size_t i = 0; i < vertices.size(); i++){
+        // the difference is computed in double, only the small result is narrowed to float
+        const Vertex& vertex = vertices[i];
+        graph.poses[i].p = {static_cast<float>(vertex.p[0] - graph.origin[0]),
+                            static_cast<float>(vertex.p[1] - graph.origin[1]),
+                            static_cast<float>(vertex.p[2] - graph.origin[2])};
+        graph.poses[i].q = vertex.q;
+        graph.vertex_ids[i] = vertex.id;
+    }
+    for(const Pose_transform& transform: options.transforms)
+        Marithmetic::transform_poses(graph.poses.data(), graph.poses.data(), graph.poses.size(), transform);
+
+    // the vertex ids are sorted, their index is found by a binary search
+    graph.edges.resize(edge_ids.size());
+    for(size_t k = 0; k < edge_ids.size(); k++){
+        size_t indices[2];
+        for(size_t end = 0; end < 2; end++){
+            auto it = std::lower_bound(graph.vertex_ids.begin(), graph.vertex_ids.end(), edge_ids[k][end]);
+            if(it == graph.vertex_ids.end() || *it != edge_ids[k][end]){
+                throw std::runtime_error("In load_pose_graph_from_g2o_file: an edge uses the unknown vertex id "
+                                         + std::to_string(edge_ids[k][end]) + ".");
+            }
+            indices[end] = static_cast<size_t>(it - graph.vertex_ids.begin());
+        }
+        // adjacent in the sorted vertex order, so the gaps in the ids (keyframes, merged sessions) do not matter
+        graph.edges[k] = {indices[0], indices[1],
+                          std::max(indices[0], indices[1]) - std::min(indices[0], indices[1]) != 1};
+    }
+
+    // the odometry measurements are given in the frame of their first g2o vertex: C_world = s^2 R C R^T with
+    // R = R_world R_vertex, only the world frame transforms apply, the camera frame convention and the
+    // inversion of the poses do not change the frame of the measurements
+    float scale2 = 1;
+    linalg::mat<float, 3, 3> world_rotation = linalg::identity;
+    for(const Pose_transform& transform: options.transforms){
+        if(transform.left){
+            scale2 *= transform.scale * transform.scale;
+            world_rotation = linalg::mul(linalg::transpose(Marithmetic::to_rot_matrix3(transform.rotation)),
+                                         world_rotation);
+        }
+    }
+    graph.covariances.assign(graph.poses.size(), {0, 0, 0, 0, 0, 0});
+    for(size_t k = 0; k < graph.edges.size(); k++){
+        const Graph_edge& edge = graph.edges[k];
+        if(edge.loop_closure)
+            continue;
+        const Covariance& c = edge_covariances[k];
+        const linalg::mat<float, 3, 3> local {{c.xx, c.xy, c.xz}, {c.xy, c.yy, c.yz}, {c.xz, c.yz, c.zz}};
+        const linalg::mat<float, 3, 3> r = linalg::mul(
+                    world_rotation, linalg::transpose(Marithmetic::to_rot_matrix3(vertices[edge.from].q)));
+        const linalg::mat<float, 3, 3> w = linalg::mul(linalg::mul(r, local), linalg::transpose(r)) * scale2;
+        const size_t later = std::max(edge.from, edge.to);
+        graph.covariances[later] = {w[0][0], w[1][0], w[2][0], w[1][1], w[2][1], w[2][2]};
+    }
+    return graph;
+}
+
+Slam_viewer::Point_cloud
+Slam_viewer::Viewer::load_point_cloud_from_file(const std::string cloud_file_path, const double leaf_size,
+                                                const Load_options& options)
+{
+    std::FILE* file = std::fopen(cloud_file_path.c_str(), "rb");
+    if(!file){
+        throw std::runtime_error("In load_point_cloud_from_file: unable to open file under: " + cloud_file_path + ".");
+    }
+    std::shared_ptr<std::FILE> file_closer(file, std::fclose);
+    auto error = [&](const std::string& message){
+        return std::runtime_error("In load_point_cloud_from_file: " + message + " (" + cloud_file_path + ").");
+    };
+
+    Point_cloud cloud;
+    bool has_origin = !(options.shift_origin && options.automatic_origin);
+    if(options.shift_origin && !options.automatic_origin)
+        cloud.origin = options.origin;
+
+    // the points are not oriented, only the transforms of the world frame move them
+    std::vector<Pose_transform> transforms;
+    for(const Pose_transform& transform: options.transforms){
+        if(transform.left){
+            transforms.push_back(transform);
+            transforms.back().invert = false;
+        }
+    }
+
+    // each block of points is shifted, transformed and given to the downsampler as soon as it is read
+    Spatial_hash::Voxel_downsampler downsampler(leaf_size);
+    std::vector<double> positions;
+    std::vector<Color> colors;
+    std::vector<Camera_pose> moved;
+    auto add_block = [&](){
+        const size_t count = colors.size();
+        if(count == 0)
+            return;
+        if(!has_origin){
+            cloud.origin = {{positions[0], positions[1], positions[2]}};
+            has_origin = true;
+        }
+        if(options.shift_origin){
+            for(size_t i = 0; i < 3 * count; i++)
+                positions[i] -= cloud.origin[i % 3];
+        }
+        if(!transforms.empty()){
+            moved.resize(count);
+            for(size_t i = 0; i < count; i++)
+                moved[i] = {{static_cast<float>(positions[3 * i]), static_cast<float>(positions[3 * i + 1]),
+                             static_cast<float>(positions[3 * i + 2])}, {0, 0, 0, 1}};
+            for(const Pose_transform& transform: transforms)
+                Marithmetic::transform_poses(moved.data(), moved.data(), count, transform);
+            for(size_t i = 0; i < count; i++){
+                positions[3 * i] = moved[i].p.x;
+                positions[3 * i + 1] = moved[i].p.y;
+                positions[3 * i + 2] = moved[i].p.z;
+            }
+        }
+        downsampler.add(positions.data(), colors.data(), count);
+        positions.clear();
+        colors.clear();
+    };
+
+    // the file is a .ply file if it starts with the 'ply' magic line, a text file otherwise
+    enum Property_type {INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64};
+    struct Property {
+        std::string name;
+        Property_type type;
+        size_t offset;
+    };
+    const Color default_color {128, 128, 128};
+    bool is_ply = false;
+    bool is_binary = false;
+    size_t num_vertices = 0;
+    std::vector<Property> properties;
+    size_t stride = 0;
+    size_t line_number = 1;
+
+    char magic[4] = {0, 0, 0, 0};
+    const size_t magic_size = std::fread(magic, 1, 4, file);
+    if(magic_size == 4 && magic[0] == 'p' && magic[1] == 'l' && magic[2] == 'y'
+            && (magic[3] == '\n' || magic[3] == '\r')){
+        is_ply = true;
+        bool in_vertices = false;
+        bool vertices_found = false;
+        bool format_found = false;
+        std::string line;
+        for(;;){
+            line.clear();
+            int c;
+            while((c = std::fgetc(file)) != EOF && c != '\n')
+                if(c != '\r')
+                    line.push_back(static_cast<char>(c));
+            if(c == EOF)
+                throw error("the .ply header has no 'end_header' line");
+            line_number++;
+            std::istringstream iss(line);
+            std::vector<std::string> words{std::istream_iterator<std::string>(iss), {}};
+            if(words.empty() || (line_number == 2 && words[0] == "ply"))
+                continue;
+            if(words[0] == "end_header")
+                break;
+            if(words[0] == "format" && words.size() >= 2){
+                if(words[1] == "binary_little_endian")
+                    is_binary = true;
+                else if(words[1] != "ascii")
+                    throw error("the .ply format '" + words[1] + "' is not supported, "
+                                "only ascii and binary_little_endian are");
+                format_found = true;
+            } else if(words[0] == "element" && words.size() >= 3){
+                in_vertices = words[1] == "vertex";
+                const size_t count = std::strtoull(words[2].c_str(), nullptr, 10);
+                if(in_vertices){
+                    num_vertices = count;
+                    vertices_found = true;
+                } else if(!vertices_found && count > 0){
+                    throw error("the element '" + words[1] + "' is before the vertices, which is not supported");
+                }
+            } else if(words[0] == "property" && in_vertices){
+                if(words.size() < 3 || words[1] == "list")
+                    throw error("the vertex property on header line " + std::to_string(line_number)
+                                + " is not supported, only scalar properties are");
+                const std::string& type = words[1];
+                Property property {words[2], INT8, stride};
+                size_t size = 1;
+                if(type == "char" || type == "int8"){
+                    property.type = INT8;
+                } else if(type == "uchar" || type == "uint8"){
+                    property.type = UINT8;
+                } else if(type == "short" || type == "int16"){
+                    property.type = INT16;
+                    size = 2;
+                } else if(type == "ushort" || type == "uint16"){
+                    property.type = UINT16;
+                    size = 2;
+                } else if(type == "int" || type == "int32"){
+                    property.type = INT32;
+                    size = 4;
+                } else if(type == "uint" || type == "uint32"){
+                    property.type = UINT32;
+                    size = 4;
+                } else if(type == "float" || type == "float32"){
+                    property.type = FLOAT32;
+                    size = 4;
+                } else if(type == "double" || type == "float64"){
+                    property.type = FLOAT64;
+                    size = 8;
+                } else {
+                    throw error("unknown .ply property type '" + type + "'");
+                }
+                properties.push_back(property);
+                stride += size;
+            }
+        }
+        if(!format_found || !vertices_found)
+            throw error("the .ply header should give the format and the vertex element");
+    } else {
+        std::rewind(file);
+    }
+
+    // properties or text columns giving x, y, z, red, green, blue, the color is optional
+    const size_t none = std::numeric_limits<size_t>::max();
+    size_t columns[6] = {0, 1, 2, 3, 4, 5};
+    bool float_colors = false;
+    if(is_ply){
+        const char* names[6] = {"x", "y", "z", "red", "green", "blue"};
+        for(size_t k = 0; k < 6; k++){
+            columns[k] = none;
+            for(size_t j = 0; j < properties.size(); j++)
+                if(properties[j].name == names[k])
+                    columns[k] = j;
+        }
+        if(columns[0] == none || columns[1] == none || columns[2] == none)
+            throw error("the .ply vertices have no x, y and z properties");
+        if(columns[3] == none || columns[4] == none || columns[5] == none)
+            columns[3] = columns[4] = columns[5] = none;
+        else
+            float_colors = properties[columns[3]].type == FLOAT32 || properties[columns[3]].type == FLOAT64;
+    }
+    auto to_channel = [float_colors](double value){
+        if(float_colors)
+            value *= 255;
+        return static_cast<uint8_t>(std::max(0.0, std::min(255.0, std::round(value))));
+    };
+    auto is_finite = [](const double* p){
+        return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+    };
+
+    if(is_ply && is_binary){
+        auto read_value = [](const uint8_t* data, const Property_type type){
+            switch(type){
+            case INT8: {int8_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            case UINT8: {uint8_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            case INT16: {int16_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            case UINT16: {uint16_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            case INT32: {int32_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            case UINT32: {uint32_t v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            case FLOAT32: {float v; std::memcpy(&v, data, sizeof(v)); return static_cast<double>(v);}
+            default: {double v; std::memcpy(&v, data, sizeof(v)); return v;}
+            }
+        };
+        const size_t block_size = 1 << 16;
+        std::vector<uint8_t> records(block_size * stride);
+        std::vector<char> valid;
+        for(size_t first = 0; first < num_vertices; first += block_size){
+            const size_t count = std::min(block_size, num_vertices - first);
+            if(std::fread(records.data(), stride, count, file) != count)
+                throw error("the file ends before its " + std::to_string(num_vertices) + " vertices");
+            positions.resize(3 * count);
+            colors.assign(count, default_color);
+            valid.assign(count, 1);
+            Parallel::parallel_for(0, count, [&](size_t begin, size_t end){
+                for(size_t i = begin; i < end; i++){
+                    const uint8_t* record = records.data() + i * stride;
+                    double* p = positions.data() + 3 * i;
+                    for(size_t k = 0; k < 3; k++)
+                        p[k] = read_value(record + properties[columns[k]].offset, properties[columns[k]].type);
+                    valid[i] = is_finite(p);
+                    if(columns[3] != none)
+                        colors[i] = {to_channel(read_value(record + properties[columns[3]].offset, properties[columns[3]].type)),
+                                     to_channel(read_value(record + properties[columns[4]].offset, properties[columns[4]].type)),
+                                     to_channel(read_value(record + properties[columns[5]].offset, properties[columns[5]].type))};
+                }
+            }, 4096);
+            for(size_t i = 0; i < count; i++)
+                if(!valid[i])
+                    throw error("the position of vertex " + std::to_string(first + i) + " is not finite");
+            add_block();
+        }
+    } else {
+        // text lines read in large blocks, the lines of a block are parsed in parallel
+        size_t num_columns = 6;
+        size_t min_columns = 3;
+        if(is_ply){
+            num_columns = 0;
+            for(size_t k = 0; k < 6; k++)
+                if(columns[k] != none)
+                    num_columns = std::max(num_columns, columns[k] + 1);
+            min_columns = num_columns;
+        }
+        const size_t max_points = is_ply ? num_vertices : none;
+        size_t num_points = 0;
+        const size_t block_size = 1 << 22;
+        std::vector<char> buffer;
+        std::vector<char*> lines;
+        std::vector<char> status;
+        size_t used = 0;
+        bool end_of_file = false;
+        while(!end_of_file && num_points < max_points){
+            buffer.resize(used + block_size + 1);
+            const size_t read = std::fread(buffer.data() + used, 1, block_size, file);
+            end_of_file = read < block_size;
+            const size_t size = used + read;
+            size_t end = size;
+            if(end_of_file){
+                buffer[size] = '\n';
+                end = size + 1;
+            } else {
+                while(end > 0 && buffer[end - 1] != '\n')
+                    end--;
+                if(end == 0){
+                    // a line longer than the block, read more of it
+                    used = size;
+                    continue;
+                }
+            }
+            lines.clear();
+            size_t start = 0;
+            for(size_t k = 0; k < end; k++){
+                if(buffer[k] == '\n'){
+                    buffer[k] = '\0';
+                    lines.push_back(buffer.data() + start);
+                    start = k + 1;
+                }
+            }
+            // the vertices of an ascii .ply file are followed by the other elements
+            if(lines.size() > max_points - num_points)
+                lines.resize(max_points - num_points);
+
+            // status 0: a point is read, 1: the line is skipped, 2: the line is not valid
+            const size_t count = lines.size();
+            positions.resize(3 * count);
+            colors.assign(count, default_color);
+            status.assign(count, 0);
+            Parallel::parallel_for(0, count, [&](size_t begin, size_t end){
+                std::vector<double> values(num_columns);
+                for(size_t i = begin; i < end; i++){
+                    const char* c = lines[i];
+                    while(*c == ' ' || *c == '\t' || *c == '\r')
+                        c++;
+                    if(*c == '\0' || *c == '#'){
+                        status[i] = is_ply ? 2 : 1;
+                        continue;
+                    }
+                    size_t n = 0;
+                    while(n < num_columns){
+                        char* next;
+                        const double value = std::strtod(c, &next);
+                        if(next == c)
+                            break;
+                        values[n++] = value;
+                        c = next;
+                    }
+                    double* p = positions.data() + 3 * i;
+                    if(n >= min_columns){
+                        p[0] = values[columns[0]];
+                        p[1] = values[columns[1]];
+                        p[2] = values[columns[2]];
+                    }
+                    if(n < min_columns || !is_finite(p)){
+                        status[i] = 2;
+                        continue;
+                    }
+                    if(columns[3] != none && n > columns[5] && n > columns[4] && n > columns[3])
+                        colors[i] = {to_channel(values[columns[3]]), to_channel(values[columns[4]]),
+                                     to_channel(values[columns[5]])};
+                }
+            }, 1024);
+
+            // the points are packed in the order of the lines
+            size_t kept = 0;
+            for(size_t i = 0; i < count; i++){
+                if(status[i] == 2){
+                    throw error("file line num '" + std::to_string(line_number + i) + "' is not a point, it should be "
+                                + (is_ply ? "a vertex of the header properties" : "on the form [x y z] or [x y z r g b]"));
+                }
+                if(status[i] == 1)
+                    continue;
+                for(size_t k = 0; k < 3; k++)
+                    positions[3 * kept + k] = positions[3 * i + k];
+                colors[kept++] = colors[i];
+            }
+            positions.resize(3 * kept);
+            colors.resize(kept);
+            num_points += kept;
+            line_number += count;
+            add_block();
+
+            if(end_of_file){
+                used = 0;
+            } else {
+                used = size - end;
+                std::memmove(buffer.data(), buffer.data() + end, used);
+            }
+        }
+        if(is_ply && num_points < num_vertices)
+            throw error("the file ends before its " + std::to_string(num_vertices) + " vertices");
+    }
+
+    cloud.points = downsampler.points();
+    cloud.num_read_points = downsampler.num_added();
+    return cloud;
+}
+
+bool Slam_viewer::Viewer::has_extension(const std::string& path, const std::string& extension)
+{
+    if(path.size() < extension.size())
+        return false;
+    return path.compare(path.length() - extension.length(), extension.length(), extension) == 0;
+}
 
 std::string Slam_viewer::Viewer::cam_idx() const
 {
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "viewer.hpp"
+#include "parallel.hpp"
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace Slam_viewer {
+namespace Writers {
+
+//  +--------------------------------------------------------
+//  |       Buffered output file
+//  +--------------------------------------------------------
+//  |
+//  | Collects the written bytes in a large memory buffer and hands
+//  | them to the OS in big blocks, numbers are formatted without iostreams
+//  | PS: This class throws std::runtime_error in case of failure
+//  |
+//  +--------------------------------------------------------
+
+class Buffered_file {
+public:
+    inline explicit Buffered_file(const std::string& path, const size_t buffer_size = 1 << 22);
+
+    inline ~Buffered_file();
+
+    Buffered_file(const Buffered_file&) = delete;
+    Buffered_file& operator=(const Buffered_file&) = delete;
+
+    //! write raw bytes to the file
+    inline void write(const void* data, const size_t size);
+
+    inline void put(const char c);
+
+    inline void put(const std::string& str);
+
+    //! write an unsigned integer in decimal form
+    inline void put_uint(const uint64_t value);
+
+    //! write a float with 7 significant digits (enough to distinguish neighbouring floats in most cases)
+    inline void put_float(const float value);
+
+    //! flush the buffer and close the file, further writes are not allowed
+    inline void close();
+
+private:
+    inline void flush();
+
+    std::FILE* m_file {nullptr};
+    std::string m_path;
+    std::vector<char> m_buffer;
+    size_t m_used {0};
+};
+
+//  +--------------------------------------------------------
+//  |       Growing binary .ply file
+//  +--------------------------------------------------------
+//  |
+//  | Writes a binary little-endian .ply file whose vertex and face counts
+//  | have a fixed width in the header, so new data is appended at the end
+//  | and the counts are patched in place: each append costs time
+//  | proportional to the appended data only.
+//  | Faces are kept in the side file '<path>.faces' until finalize()
+//  | moves them after the vertices, before that the file is a valid
+//  | point cloud (the face count stays 0).
+//  | PS: This class throws std::runtime_error in case of failure
+//  |
+//  +--------------------------------------------------------
+
+class Ply_appender {
+public:
+    //! create the .ply file and its side faces file (existing files are overwritten),
+    //! each comment is written on its own header line
+    inline explicit Ply_appender(const std::string& path, const std::vector<std::string>& comments = {});
+
+    inline ~Ply_appender();
+
+    Ply_appender(const Ply_appender&) = delete;
+    Ply_appender& operator=(const Ply_appender&) = delete;
+
+    //! append points and triangles, the triangles indices are relative to the appended points
+    inline void append(const std::vector<Point>& points, const std::vector<Triangle>& triangles);
+
+    //! move the faces after the vertices and close the file, no data can be appended after this call
+    inline void finalize();
+
+    inline size_t num_vertices() const {return m_num_vertices;}
+
+    inline size_t num_faces() const {return m_num_faces;}
+
+private:
+    inline void patch_count(const long offset, const size_t count);
+
+    inline void check(const bool ok, const std::string& action) const;
+
+    std::string m_path;
+    std::FILE* m_file {nullptr};
+    std::FILE* m_faces_file {nullptr};
+    size_t m_num_vertices {0};
+    size_t m_num_faces {0};
+    long m_vertex_count_offset {0};
+    long m_face_count_offset {0};
+};
+
+//  +--------------------------------------------------------
+//  |       Binary glTF 2.0 (.glb) builder
+//  +--------------------------------------------------------
+//  |
+//  | Packs the meshes in the binary chunk of a single .glb file and
+//  | describes them in the JSON chunk, no external glTF library is used
+//  | PS: the binary data is written in the host byte order, which is
+//  | little-endian on all supported platforms
+//  |
+//  +--------------------------------------------------------
+
+class Glb_builder {
+public:
+    inline Glb_builder(){}
+
+    //! add the triangles and edges as a mesh with COLOR_0 vertex colors and a node showing it, returns the node index.
+    //! If quantize is true, positions are stored as int16 relative to the bounding box (KHR_mesh_quantization)
+    inline size_t add_mesh_node(const std::vector<Point>& points,
+                                const std::vector<Triangle>& triangles,
+                                const std::vector<Edge>& edges,
+                                const bool quantize);
+
+    //! add the template triangles once and a node drawing one copy of it for each pose (EXT_mesh_gpu_instancing),
+    //! each copy is rotated by pose.q, translated by pose.p and tinted by its color (custom '_COLOR_0' attribute)
+    inline size_t add_instanced_mesh_node(const std::vector<Point>& template_points,
+                                          const std::vector<Triangle>& template_triangles,
+                                          const std::vector<Camera_pose>& poses,
+                                          const std::vector<Color>& colors);
+
+    //! comments saved in the asset extras of the JSON chunk
+    inline void set_comments(const std::vector<std::string>& comments)
+    {m_comments = comments;}
+
+    //! save the .glb file containing all added nodes in one scene
+    inline void write(const std::string& output_path) const;
+
+private:
+    inline size_t add_mesh(const std::vector<Point>& points,
+                           const std::vector<Triangle>& triangles,
+                           const std::vector<Edge>& edges,
+                           const bool quantize, const bool with_colors,
+                           std::string& node_transform);
+
+    inline size_t add_buffer_view(const void* data, const size_t size,
+                                  const int target, const size_t byte_stride = 0);
+
+    inline size_t add_accessor(const size_t buffer_view, const int component_type,
+                               const size_t count, const std::string& type,
+                               const bool normalized,
+                               const std::vector<double>& min = {},
+                               const std::vector<double>& max = {});
+
+    inline void use_extension(const std::string& name, const bool required);
+
+    //! indices as uint16 if num_vertices allows it (the largest uint16 is the primitive restart value), uint32 otherwise
+    inline size_t add_indices_accessor(const void* indices, const size_t count, const size_t num_vertices);
+
+    static inline std::string json_number(const double value);
+
+    static inline std::string json_array(const std::vector<double>& values);
+
+    std::vector<uint8_t> m_binary;
+    std::vector<std::string> m_buffer_views;
+    std::vector<std::string> m_accessors;
+    std::vector<std::string> m_meshes;
+    std::vector<std::string> m_nodes;
+    std::vector<std::string> m_extensions_used;
+    std::vector<std::string> m_extensions_required;
+    std::vector<std::string> m_comments;
+};
+
+//! a 2D polyline drawn with a single color, its coordinates are in pixels
+struct Svg_polyline {
+    Color color;
+    std::vector<std::array<float, 2>> points;
+};
+
+//! write the float 'value' to 'out' in decimal form and return the number of written chars (at most 24)
+inline size_t format_float(const float value, char* out);
+
+//! quote and escape str as a JSON string, control characters are dropped
+inline std::string json_string(const std::string& str);
+
+//! write the unsigned integer 'value' to 'out' in decimal form and return the number of written chars (at most 20)
+inline size_t format_uint(uint64_t value, char* out);
+
+//  +--------------------------------------------------------
+//  |       Mesh files
+//  +--------------------------------------------------------
+//  |
+//  | The comments are free lines written in the header of the files
+//  | ('comment' lines in .ply, '#' lines in .obj and the asset extras
+//  | of .glb), e.g. the origin the positions are relative to
+//  |
+//  +--------------------------------------------------------
+
+//! save the points, triangles and edges as an ASCII .ply file
+inline void write_ply(const std::string& output_path,
+                      const std::vector<Point>& points,
+                      const std::vector<Triangle>& triangles,
+                      const std::vector<Edge>& edges,
+                      const std::vector<std::string>& comments = {});
+
+//! save the points, triangles and edges as a binary little-endian .ply file: 15 bytes per vertex (3 floats and
+//! 3 uchar colors) and the narrowest index type for the vertex count, ushort up to 65536 vertices, uint above
+inline void write_binary_ply(const std::string& output_path,
+                             const std::vector<Point>& points,
+                             const std::vector<Triangle>& triangles,
+                             const std::vector<Edge>& edges,
+                             const std::vector<std::string>& comments = {});
+
+//! save the points, triangles and edges as a Wavefront .obj file with colors appended to the vertices: 'v x y z r g b'
+inline void write_obj(const std::string& output_path,
+                      const std::vector<Point>& points,
+                      const std::vector<Triangle>& triangles,
+                      const std::vector<Edge>& edges,
+                      const std::vector<std::string>& comments = {});
+
+//! save the points, triangles and edges as a binary glTF 2.0 .glb file with vertex colors,
+//! if quantize is true the KHR_mesh_quantization extension is used to store positions as int16
+inline void write_glb(const std::string& output_path,
+                      const std::vector<Point>& points,
+                      const std::vector<Triangle>& triangles,
+                      const std::vector<Edge>& edges,
+                      const bool quantize,
+                      const std::vector<std::string>& comments = {});
+
+//! same as write_glb, plus one instance of the camera template for each of the camera poses
+inline void write_instanced_glb(const std::string& output_path,
+                                const std::vector<Point>& points,
+                                const std::vector<Triangle>& triangles,
+                                const std::vector<Edge>& edges,
+                                const bool quantize,
+                                const std::vector<Point>& camera_points,
+                                const std::vector<Triangle>& camera_triangles,
+                                const std::vector<Camera_pose>& camera_poses,
+                                const std::vector<Color>& camera_colors,
+                                const std::vector<std::string>& comments = {});
+
+//! save an 8 bits RGB image (row major, 3 bytes per pixel) as a .png file, the zlib stream is
+//! compressed with the fixed Huffman codes and matches with the previous pixel or the pixel above
+inline void write_png(const std::string& output_path,
+                      const std::vector<uint8_t>& rgb,
+                      const size_t width,
+                      const size_t height);
+
+//! save the polylines as a width x height .svg image, polylines made of a single point are drawn as discs
+inline void write_svg(const std::string& output_path,
+                      const size_t width,
+                      const size_t height,
+                      const std::vector<Svg_polyline>& polylines,
+                      const float stroke_width);
+
+//! save the points, triangles and edges in the format given by the extension of output_path:
+//! '.obj', '.glb' or '.ply' (used for any other extension), binary if binary_ply is true
+inline void write_mesh_file(const std::string& output_path,
+                            const std::vector<Point>& points,
+                            const std::vector<Triangle>& triangles,
+                            const std::vector<Edge>& edges,
+                            const bool quantize,
+                            const std::vector<std::string>& comments = {},
+                            const bool binary_ply = false);
+
+//! split the geometry in a regular grid of cubic tiles of side tile_size, each element goes to the tile
+//! holding its center and each tile is saved as its own file '<stem>_tile_<i>_<j>_<k><extension>'.
+//! A manifest '<stem>_tiles.json' gives the files, bounds and element counts of all tiles and the comments
+inline void write_tiles(const std::string& output_path,
+                        const std::vector<Point>& points,
+                        const std::vector<Triangle>& triangles,
+                        const std::vector<Edge>& edges,
+                        const float tile_size,
+                        const bool quantize,
+                        const std::vector<std::string>& comments = {},
+                        const bool binary_ply = false);
+
+}
+}
+
+#include "writers_impl.hpp"
@@ -0,0 +1,1277 @@
+#pragma once
+#include "writers.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+
+Slam_viewer::Writers::Buffered_file::Buffered_file(const std::string& path, const size_t buffer_size)
+    : m_path(path), m_buffer(buffer_size < 64 ? 64 : buffer_size)
+{
+    m_file = std::fopen(path.c_str(), "wb");
+    if(m_file == nullptr){
+        throw std::runtime_error("In Buffered_file: unable to open file under: " + path + ".");
+    }
+}
+
+Slam_viewer::Writers::Buffered_file::~Buffered_file()
+{
+    if(m_file == nullptr)
+        return;
+    // errors can not be reported from a destructor, use close() to catch them
+    std::fwrite(m_buffer.data(), 1, m_used, m_file);
+    std::fclose(m_file);
+}
+
+void Slam_viewer::Writers::Buffered_file::write(const void* data, const size_t size)
+{
+    if(m_used + size > m_buffer.size()){
+        flush();
+        if(size > m_buffer.size()){
+            if(std::fwrite(data, 1, size, m_file) != size)
+                throw std::runtime_error("In Buffered_file: unable to write to file: " + m_path + ".");
+            return;
+        }
+    }
+    std::memcpy(m_buffer.data() + m_used, data, size);
+    m_used += size;
+}
+
+void Slam_viewer::Writers::Buffered_file::put(const char c)
+{
+    if(m_used == m_buffer.size())
+        flush();
+    m_buffer[m_used++] = c;
+}
+
+void Slam_viewer::Writers::Buffered_file::put(const std::string& str)
+{
+    write(str.data(), str.size());
+}
+
+void Slam_viewer::Writers::Buffered_file::put_uint(const uint64_t value)
+{
+    if(m_used + 24 > m_buffer.size())
+        flush();
+    m_used += format_uint(value, m_buffer.data() + m_used);
+}
+
+void Slam_viewer::Writers::Buffered_file::put_float(const float value)
+{
+    if(m_used + 32 > m_buffer.size())
+        flush();
+    m_used += format_float(value, m_buffer.data() + m_used);
+}
+
+void Slam_viewer::Writers::Buffered_file::close()
+{
+    if(m_file == nullptr)
+        return;
+    flush();
+    int res = std::fclose(m_file);
+    m_file = nullptr;
+    if(res != 0)
+        throw std::runtime_error("In Buffered_file: unable to close file: " + m_path + ".");
+}
+
+void Slam_viewer::Writers::Buffered_file::flush()
+{
+    if(m_file == nullptr)
+        throw std::runtime_error("In Buffered_file: writing to the closed file: " + m_path + ".");
+    if(m_used != 0 && std::fwrite(m_buffer.data(), 1, m_used, m_file) != m_used)
+        throw std::runtime_error("In Buffered_file: unable to write to file: " + m_path + ".");
+    m_used = 0;
+}
+
+
+Slam_viewer::Writers::Ply_appender::Ply_appender(const std::string& path, const std::vector<std::string>& comments)
+    : m_path(path)
+{
+    m_file = std::fopen(path.c_str(), "w+b");
+    check(m_file != nullptr, "open");
+    m_faces_file = std::fopen((path + ".faces").c_str(), "w+b");
+    if(m_faces_file == nullptr){
+        std::fclose(m_file);
+        m_file = nullptr;
+        throw std::runtime_error("In Ply_appender: unable to open file under: " + path + ".faces.");
+    }
+
+    // counts are written on 20 chars (enough for any uint64) followed by spaces
+    const std::string blank_count(20, ' ');
+    std::string header = "ply\nformat binary_little_endian 1.0\ncomment Slam Viewer generated\n";
+    for(auto& comment: comments)
+        header += "comment " + comment + "\n";
+    header += "element vertex ";
+    m_vertex_count_offset = static_cast<long>(header.size());
+    header += blank_count + "\n";
+    header += "property float x\nproperty float y\nproperty float z\n"
+              "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    header += "element face ";
+    m_face_count_offset = static_cast<long>(header.size());
+    header += blank_count + "\n";
+    header += "property list uchar uint vertex_indices\nend_header\n";
+    check(std::fwrite(header.data(), 1, header.size(), m_file) == header.size(), "write");
+    patch_count(m_vertex_count_offset, 0);
+    patch_count(m_face_count_offset, 0);
+}
+
+Slam_viewer::Writers::Ply_appender::~Ply_appender()
+{
+    // an unfinished file stays a valid point cloud, only the side file is left behind
+    if(m_file != nullptr)
+        std::fclose(m_file);
+    if(m_faces_file != nullptr)
+        std::fclose(m_faces_file);
+}
+
+void Slam_viewer::Writers::Ply_appender::append(const std::vector<Point>& points,
+                                                const std::vector<Triangle>& triangles)
+{
+    if(m_file == nullptr){
+        throw std::runtime_error("In Ply_appender: appending to the finalized file: " + m_path + ".");
+    }
+    const uint64_t bias = m_num_vertices;
+    if(bias + points.size() > 0xFFFFFFFFull){
+        throw std::runtime_error("In Ply_appender: too many vertices for uint32 indices in: " + m_path + ".");
+    }
+
+    // binary records: 3 float + 3 uchar per vertex, uchar 3 + 3 uint per face (host is little-endian)
+    std::vector<uint8_t> buffer(15 * points.size());
+    for(size_t i = 0; i < points.size(); i++){
+        uint8_t* record = buffer.data() + 15 * i;
+        std::memcpy(record + 0, &points[i].x, 4);
+        std::memcpy(record + 4, &points[i].y, 4);
+        std::memcpy(record + 8, &points[i].z, 4);
+        record[12] = points[i].c.r;
+        record[13] = points[i].c.g;
+        record[14] = points[i].c.b;
+    }
+    check(std::fseek(m_file, 0, SEEK_END) == 0, "seek");
+    check(std::fwrite(buffer.data(), 1, buffer.size(), m_file) == buffer.size(), "write");
+
+    buffer.resize(13 * triangles.size());
+    for(size_t i = 0; i < triangles.size(); i++){
+        uint8_t* record = buffer.data() + 13 * i;
+        const uint32_t indices[3] = {static_cast<uint32_t>(triangles[i].a + bias),
+                                     static_cast<uint32_t>(triangles[i].b + bias),
+                                     static_cast<uint32_t>(triangles[i].c + bias)};
+        record[0] = 3;
+        std::memcpy(record + 1, indices, 12);
+    }
+    check(std::fwrite(buffer.data(), 1, buffer.size(), m_faces_file) == buffer.size(), "write");
+
+    m_num_vertices += points.size();
+    m_num_faces += triangles.size();
+    patch_count(m_vertex_count_offset, m_num_vertices);
+    check(std::fflush(m_file) == 0 && std::fflush(m_faces_file) == 0, "flush");
+}
+
+void Slam_viewer::Writers::Ply_appender::finalize()
+{
+    if(m_file == nullptr)
+        return;
+
+    check(std::fseek(m_faces_file, 0, SEEK_SET) == 0 && std::fseek(m_file, 0, SEEK_END) == 0, "seek");
+    std::vector<char> block(1 << 22);
+    size_t read;
+    while((read = std::fread(block.data(), 1, block.size(), m_faces_file)) > 0)
+        check(std::fwrite(block.data(), 1, read, m_file) == read, "write");
+    check(!std::ferror(m_faces_file), "read");
+    patch_count(m_face_count_offset, m_num_faces);
+
+    int res = std::fclose(m_file);
+    m_file = nullptr;
+    std::fclose(m_faces_file);
+    m_faces_file = nullptr;
+    check(res == 0, "close");
+    std::remove((m_path + ".faces").c_str());
+}
+
+void Slam_viewer::Writers::Ply_appender::patch_count(const long offset, const size_t count)
+{
+    char digits[24];
+    size_t len = format_uint(count, digits);
+    check(std::fseek(m_file, offset, SEEK_SET) == 0, "seek");
+    check(std::fwrite(digits, 1, len, m_file) == len, "write");
+}
+
+void Slam_viewer::Writers::Ply_appender::check(const bool ok, const std::string& action) const
+{
+    if(!ok){
+        throw std::runtime_error("In Ply_appender: unable to " + action + " file: " + m_path + ".");
+    }
+}
+
+
+size_t Slam_viewer::Writers::format_uint(uint64_t value, char* out)
+{
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while(value != 0);
+
+    for(size_t i = 0; i < n; i++)
+        out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+size_t Slam_viewer::Writers::format_float(const float value, char* out)
+{
+    static const uint64_t pow10[] = {1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull,
+                                     1000000ull, 10000000ull, 100000000ull,
+                                     1000000000ull, 10000000000ull};
+    double v = static_cast<double>(value);
+    if(std::isnan(v)){
+        std::memcpy(out, "nan", 3);
+        return 3;
+    }
+    if(v == 0){
+        out[0] = '0';
+        return 1;
+    }
+
+    size_t n = 0;
+    if(v < 0){
+        out[n++] = '-';
+        v = -v;
+    }
+    if(std::isinf(v)){
+        std::memcpy(out + n, "inf", 3);
+        return n + 3;
+    }
+
+    // very small and very large numbers are rare, leave them to the C library
+    if(v < 1e-4 || v >= 1e9)
+        return n + static_cast<size_t>(std::snprintf(out + n, 24, "%.7g", v));
+
+    // choose the number of decimals that keeps 7 significant digits
+    int decimals;
+    if(v >= 1){
+        int int_digits = 1;
+        double p = 10;
+        while(v >= p){
+            int_digits++;
+            p *= 10;
+        }
+        decimals = int_digits >= 7 ? 0 : 7 - int_digits;
+    } else {
+        int leading_zeros = 1;
+        double p = 0.1;
+        while(v < p){
+            leading_zeros++;
+            p *= 0.1;
+        }
+        decimals = 6 + leading_zeros;
+    }
+
+    uint64_t scaled = static_cast<uint64_t>(std::llround(v * static_cast<double>(pow10[decimals])));
+    n += format_uint(scaled / pow10[decimals], out + n);
+
+    uint64_t frac = scaled % pow10[decimals];
+    if(frac == 0)
+        return n;
+
+    // remove trailing zeros of the fractional part
+    while(frac % 10 == 0){
+        frac /= 10;
+        decimals--;
+    }
+    out[n++] = '.';
+    for(int i = decimals - 1; i >= 0; i--){
+        out[n + static_cast<size_t>(i)] = static_cast<char>('0' + frac % 10);
+        frac /= 10;
+    }
+    return n + static_cast<size_t>(decimals);
+}
+
+
+void Slam_viewer::Writers::write_ply(const std::string& output_path,
+                                     const std::vector<Point>& points,
+                                     const std::vector<Triangle>& triangles,
+                                     const std::vector<Edge>& edges,
+                                     const std::vector<std::string>& comments)
+{
+    std::ofstream strm(output_path);
+    if(!strm){
+        throw std::runtime_error("In write_ply: unable to open file under: " + output_path + ".");
+    }
+    strm << "ply\n";
+    strm << "format ascii 1.0\n";
+    strm << "comment Slam Viewer generated\n";
+    for(auto& comment: comments)
+        strm << "comment " << comment << "\n";
+    strm << "element vertex " << points.size()<< "\n";
+    strm << "property float x\n";
+    strm << "property float y\n";
+    strm << "property float z\n";
+    strm << "property uchar red\n";
+    strm << "property uchar green\n";
+    strm << "property uchar blue\n";
+    strm << "element face " << triangles.size() <<"\n";
+    strm << "property list uchar int vertex_indices\n";
+    if(!edges.empty()){
+        strm << "element edge " << edges.size() << "\n";
+        strm << "property int vertex1\n";
+        strm << "property int vertex2\n";
+    }
+    strm << "end_header\n";
+    for(auto& p: points)
+        strm << p.x << " " << p.y << " " << p.z << " "
+             << static_cast<int>(p.c.r) << " " << static_cast<int>(p.c.g)
+             << " " << static_cast<int>(p.c.b) << "\n";
+
+    for(auto& t: triangles)
+        strm << "3 " <<  t.a << " " << t.b << " "  << t.c << "\n";
+
+    for(auto& e: edges)
+        strm << e.a << " " << e.b << "\n";
+
+    strm.close();
+}
+
+void Slam_viewer::Writers::write_binary_ply(const std::string& output_path,
+                                            const std::vector<Point>& points,
+                                            const std::vector<Triangle>& triangles,
+                                            const std::vector<Edge>& edges,
+                                            const std::vector<std::string>& comments)
+{
+    // ushort indices halve the faces and edges of small meshes (tiles, keyframes...)
+    const bool short_indices = points.size() <= 0x10000;
+    const std::string index_type = short_indices ? "ushort" : "uint";
+    const size_t index_size = short_indices ? 2 : 4;
+
+    Buffered_file file(output_path);
+    file.put("ply\nformat binary_little_endian 1.0\ncomment Slam Viewer generated\n");
+    for(auto& comment: comments)
+        file.put("comment " + comment + "\n");
+    file.put("element vertex " + std::to_string(points.size()) + "\n");
+    file.put("property float x\nproperty float y\nproperty float z\n"
+             "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+    file.put("element face " + std::to_string(triangles.size()) + "\n");
+    file.put("property list uchar " + index_type + " vertex_indices\n");
+    if(!edges.empty()){
+        file.put("element edge " + std::to_string(edges.size()) + "\n");
+        file.put("property " + index_type + " vertex1\nproperty " + index_type + " vertex2\n");
+    }
+    file.put("end_header\n");
+
+    // binary records: 3 float + 3 uchar per vertex, uchar 3 + 3 indices per face (host is little-endian)
+    uint8_t record[15];
+    for(auto& p: points){
+        std::memcpy(record + 0, &p.x, 4);
+        std::memcpy(record + 4, &p.y, 4);
+        std::memcpy(record + 8, &p.z, 4);
+        record[12] = p.c.r;
+        record[13] = p.c.g;
+        record[14] = p.c.b;
+        file.write(record, 15);
+    }
+    auto put_index = [&](const uint32_t index, uint8_t* out){
+        if(short_indices){
+            const uint16_t narrow = static_cast<uint16_t>(index);
+            std::memcpy(out, &narrow, 2);
+        } else {
+            std::memcpy(out, &index, 4);
+        }
+    };
+    record[0] = 3;
+    for(auto& t: triangles){
+        put_index(t.a, record + 1);
+        put_index(t.b, record + 1 + index_size);
+        put_index(t.c, record + 1 + 2 * index_size);
+        file.write(record, 1 + 3 * index_size);
+    }
+    for(auto& e: edges){
+        put_index(e.a, record);
+        put_index(e.b, record + index_size);
+        file.write(record, 2 * index_size);
+    }
+    file.close();
+}
+
+void Slam_viewer::Writers::write_obj(const std::string& output_path,
+                                     const std::vector<Point>& points,
+                                     const std::vector<Triangle>& triangles,
+                                     const std::vector<Edge>& edges,
+                                     const std::vector<std::string>& comments)
+{
+    // colors are written as floats in [0, 1], there are only 256 of them
+    std::vector<std::string> color_table(256);
+    for(size_t i = 0; i < 256; i++){
+        char tmp[32];
+        size_t len = format_float(static_cast<float>(i) / 255.0f, tmp);
+        color_table[i].assign(tmp, len);
+    }
+
+    Buffered_file file(output_path);
+    file.put("# Slam Viewer generated\n");
+    for(auto& comment: comments)
+        file.put("# " + comment + "\n");
+    file.put("# vertices: " + std::to_string(points.size())
+             + " faces: " + std::to_string(triangles.size())
+             + " edges: " + std::to_string(edges.size()) + "\n");
+
+    for(auto& p: points){
+        file.write("v ", 2);
+        file.put_float(p.x);
+        file.put(' ');
+        file.put_float(p.y);
+        file.put(' ');
+        file.put_float(p.z);
+        file.put(' ');
+        file.put(color_table[p.c.r]);
+        file.put(' ');
+        file.put(color_table[p.c.g]);
+        file.put(' ');
+        file.put(color_table[p.c.b]);
+        file.put('\n');
+    }
+
+    // obj indices start from 1
+    for(auto& t: triangles){
+        file.write("f ", 2);
+        file.put_uint(static_cast<uint64_t>(t.a) + 1);
+        file.put(' ');
+        file.put_uint(static_cast<uint64_t>(t.b) + 1);
+        file.put(' ');
+        file.put_uint(static_cast<uint64_t>(t.c) + 1);
+        file.put('\n');
+    }
+    for(auto& e: edges){
+        file.write("l ", 2);
+        file.put_uint(static_cast<uint64_t>(e.a) + 1);
+        file.put(' ');
+        file.put_uint(static_cast<uint64_t>(e.b) + 1);
+        file.put('\n');
+    }
+    file.close();
+}
+
+
+size_t Slam_viewer::Writers::Glb_builder::add_mesh_node(const std::vector<Point>& points,
+                                                        const std::vector<Triangle>& triangles,
+                                                        const std::vector<Edge>& edges,
+                                                        const bool quantize)
+{
+    std::string node_transform;
+    size_t mesh = add_mesh(points, triangles, edges, quantize, true, node_transform);
+    m_nodes.push_back("{\"mesh\":" + std::to_string(mesh) + node_transform + "}");
+    return m_nodes.size() - 1;
+}
+
+size_t Slam_viewer::Writers::Glb_builder::add_instanced_mesh_node(
+        const std::vector<Point>& template_points,
+        const std::vector<Triangle>& template_triangles,
+        const std::vector<Camera_pose>& poses,
+        const std::vector<Color>& colors)
+{
+    if(poses.empty() || poses.size() != colors.size()){
+        throw std::runtime_error("In Glb_builder: instances poses and colors should have the same non zero size.");
+    }
+    use_extension("EXT_mesh_gpu_instancing", true);
+
+    // the instance transform is applied in the node space, so the template can not be quantized
+    std::string node_transform;
+    size_t mesh = add_mesh(template_points, template_triangles, {}, false, false, node_transform);
+
+    const size_t n = poses.size();
+    std::vector<float> translations(3 * n), rotations(4 * n), tints(3 * n);
+    for(size_t i = 0; i < n; i++){
+        translations[3 * i + 0] = poses[i].p.x;
+        translations[3 * i + 1] = poses[i].p.y;
+        translations[3 * i + 2] = poses[i].p.z;
+        rotations[4 * i + 0] = poses[i].q.x;
+        rotations[4 * i + 1] = poses[i].q.y;
+        rotations[4 * i + 2] = poses[i].q.z;
+        rotations[4 * i + 3] = poses[i].q.w;
+        tints[3 * i + 0] = colors[i].r / 255.0f;
+        tints[3 * i + 1] = colors[i].g / 255.0f;
+        tints[3 * i + 2] = colors[i].b / 255.0f;
+    }
+    size_t translation_accessor = add_accessor(
+                add_buffer_view(translations.data(), translations.size() * sizeof(float), 0),
+                5126, n, "VEC3", false);
+    size_t rotation_accessor = add_accessor(
+                add_buffer_view(rotations.data(), rotations.size() * sizeof(float), 0),
+                5126, n, "VEC4", false);
+    size_t color_accessor = add_accessor(
+                add_buffer_view(tints.data(), tints.size() * sizeof(float), 0),
+                5126, n, "VEC3", false);
+
+    m_nodes.push_back("{\"mesh\":" + std::to_string(mesh)
+                      + ",\"extensions\":{\"EXT_mesh_gpu_instancing\":{\"attributes\":{"
+                      + "\"TRANSLATION\":" + std::to_string(translation_accessor)
+                      + ",\"ROTATION\":" + std::to_string(rotation_accessor)
+                      + ",\"_COLOR_0\":" + std::to_string(color_accessor) + "}}}}");
+    return m_nodes.size() - 1;
+}
+
+size_t Slam_viewer::Writers::Glb_builder::add_mesh(const std::vector<Point>& points,
+                                                   const std::vector<Triangle>& triangles,
+                                                   const std::vector<Edge>& edges,
+                                                   const bool quantize, const bool with_colors,
+                                                   std::string& node_transform)
+{
+    node_transform.clear();
+    if(points.empty()){
+        throw std::runtime_error("In Glb_builder: the mesh has no vertices.");
+    }
+    const size_t n = points.size();
+
+    float min[3] = {points[0].x, points[0].y, points[0].z};
+    float max[3] = {points[0].x, points[0].y, points[0].z};
+    for(auto& p: points){
+        const float v[3] = {p.x, p.y, p.z};
+        for(size_t j = 0; j < 3; j++){
+            min[j] = std::min(min[j], v[j]);
+            max[j] = std::max(max[j], v[j]);
+        }
+    }
+
+    size_t position_accessor;
+    if(!quantize){
+        std::vector<float> positions(3 * n);
+        for(size_t i = 0; i < n; i++){
+            positions[3 * i + 0] = points[i].x;
+            positions[3 * i + 1] = points[i].y;
+            positions[3 * i + 2] = points[i].z;
+        }
+        size_t view = add_buffer_view(positions.data(), positions.size() * sizeof(float), 34962);
+        position_accessor = add_accessor(view, 5126, n, "VEC3", false,
+                                         {min[0], min[1], min[2]}, {max[0], max[1], max[2]});
+    } else {
+        use_extension("KHR_mesh_quantization", true);
+
+        // positions are mapped to [-32767, 32767] inside the bounding box,
+        // the node transform maps them back to the original coordinates
+        double center[3], scale[3];
+        for(size_t j = 0; j < 3; j++){
+            center[j] = (static_cast<double>(min[j]) + static_cast<double>(max[j])) / 2;
+            scale[j] = (static_cast<double>(max[j]) - static_cast<double>(min[j])) / 2 / 32767;
+            if(scale[j] <= 0)
+                scale[j] = 1;
+        }
+
+        // int16 VEC3 padded to 8 bytes, vertex attributes strides must be a multiple of 4
+        std::vector<int16_t> positions(4 * n, 0);
+        std::vector<double> qmin(3, 32767), qmax(3, -32767);
+        for(size_t i = 0; i < n; i++){
+            const float v[3] = {points[i].x, points[i].y, points[i].z};
+            for(size_t j = 0; j < 3; j++){
+                double q = std::round((static_cast<double>(v[j]) - center[j]) / scale[j]);
+                q = std::max(-32767.0, std::min(32767.0, q));
+                positions[4 * i + j] = static_cast<int16_t>(q);
+                qmin[j] = std::min(qmin[j], q);
+                qmax[j] = std::max(qmax[j], q);
+            }
+        }
+        size_t view = add_buffer_view(positions.data(), positions.size() * sizeof(int16_t), 34962, 8);
+        position_accessor = add_accessor(view, 5122, n, "VEC3", false, qmin, qmax);
+
+        node_transform += ",\"translation\":" + json_array({center[0], center[1], center[2]});
+        node_transform += ",\"scale\":" + json_array({scale[0], scale[1], scale[2]});
+    }
+
+    std::string attributes = "{\"POSITION\":" + std::to_string(position_accessor);
+    if(with_colors){
+        // uint8 RGB padded to 4 bytes
+        std::vector<uint8_t> colors(4 * n, 255);
+        for(size_t i = 0; i < n; i++){
+            colors[4 * i + 0] = points[i].c.r;
+            colors[4 * i + 1] = points[i].c.g;
+            colors[4 * i + 2] = points[i].c.b;
+        }
+        size_t color_view = add_buffer_view(colors.data(), colors.size(), 34962, 4);
+        size_t color_accessor = add_accessor(color_view, 5121, n, "VEC3", true);
+        attributes += ",\"COLOR_0\":" + std::to_string(color_accessor);
+    }
+    attributes += "}";
+
+    // one primitive per element type, all sharing the same vertices
+    std::vector<std::string> primitives;
+    std::string primitive = "{\"attributes\":" + attributes + ",\"material\":0";
+    if(!triangles.empty()){
+        size_t indices_accessor = add_indices_accessor(triangles.data(), 3 * triangles.size(), n);
+        primitives.push_back(primitive + ",\"indices\":" + std::to_string(indices_accessor) + ",\"mode\":4}");
+    }
+    if(!edges.empty()){
+        size_t indices_accessor = add_indices_accessor(edges.data(), 2 * edges.size(), n);
+        primitives.push_back(primitive + ",\"indices\":" + std::to_string(indices_accessor) + ",\"mode\":1}");
+    }
+    if(primitives.empty()){
+        primitives.push_back(primitive + ",\"mode\":0}");
+    } else {
+        // the vertices no triangle or edge uses (e.g. map points) are drawn as points
+        std::vector<char> used(n, 0);
+        for(const Triangle& t: triangles){
+            if(t.a >= n || t.b >= n || t.c >= n){
+                throw std::runtime_error("In Glb_builder: triangle index out of range.");
+            }
+            used[t.a] = used[t.b] = used[t.c] = 1;
+        }
+        for(const Edge& e: edges){
+            if(e.a >= n || e.b >= n){
+                throw std::runtime_error("In Glb_builder: edge index out of range.");
+            }
+            used[e.a] = used[e.b] = 1;
+        }
+        std::vector<uint32_t> unused;
+        for(size_t i = 0; i < n; i++)
+            if(!used[i])
+                unused.push_back(static_cast<uint32_t>(i));
+        if(!unused.empty()){
+            size_t indices_accessor = add_indices_accessor(unused.data(), unused.size(), n);
+            primitives.push_back(primitive + ",\"indices\":" + std::to_string(indices_accessor) + ",\"mode\":0}");
+        }
+    }
+
+    std::string mesh = "{\"primitives\":[";
+    for(size_t i = 0; i < primitives.size(); i++)
+        mesh += (i == 0 ? "" : ",") + primitives[i];
+    m_meshes.push_back(mesh + "]}");
+    return m_meshes.size() - 1;
+}
+
+void Slam_viewer::Writers::Glb_builder::write(const std::string& output_path) const
+{
+    if(m_nodes.empty()){
+        throw std::runtime_error("In Glb_builder: there is no mesh to save under: " + output_path + ".");
+    }
+    auto join = [](const std::vector<std::string>& items){
+        std::string res = "[";
+        for(size_t i = 0; i < items.size(); i++)
+            res += (i == 0 ? "" : ",") + items[i];
+        return res + "]";
+    };
+    std::vector<std::string> node_indices;
+    for(size_t i = 0; i < m_nodes.size(); i++)
+        node_indices.push_back(std::to_string(i));
+    std::vector<std::string> extensions_used, extensions_required;
+    for(auto& e: m_extensions_used)
+        extensions_used.push_back("\"" + e + "\"");
+    for(auto& e: m_extensions_required)
+        extensions_required.push_back("\"" + e + "\"");
+
+    std::vector<std::string> comments;
+    for(auto& c: m_comments)
+        comments.push_back(json_string(c));
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Slam Viewer\"";
+    if(!comments.empty())
+        json += ",\"extras\":{\"comments\":" + join(comments) + "}";
+    json += "}";
+    if(!extensions_used.empty())
+        json += ",\"extensionsUsed\":" + join(extensions_used);
+    if(!extensions_required.empty())
+        json += ",\"extensionsRequired\":" + join(extensions_required);
+    json += ",\"scene\":0,\"scenes\":[{\"nodes\":" + join(node_indices) + "}]";
+    json += ",\"nodes\":" + join(m_nodes);
+    json += ",\"meshes\":" + join(m_meshes);
+    json += ",\"materials\":[{\"pbrMetallicRoughness\":{\"metallicFactor\":0,\"roughnessFactor\":1},"
+            "\"doubleSided\":true}]";
+    json += ",\"accessors\":" + join(m_accessors);
+    json += ",\"bufferViews\":" + join(m_buffer_views);
+    json += ",\"buffers\":[{\"byteLength\":" + std::to_string(m_binary.size()) + "}]}";
+
+    // both chunks have to be 4 bytes aligned
+    while(json.size() % 4 != 0)
+        json += ' ';
+    const size_t binary_padding = (4 - m_binary.size() % 4) % 4;
+    const size_t binary_size = m_binary.size() + binary_padding;
+
+    auto put_uint32 = [](Buffered_file& file, const uint64_t value){
+        if(value > 0xFFFFFFFFull)
+            throw std::runtime_error("In Glb_builder: the file exceeds the 4GB limit of the .glb format.");
+        uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                            static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+        file.write(bytes, 4);
+    };
+
+    Buffered_file file(output_path);
+    put_uint32(file, 0x46546C67);  // "glTF"
+    put_uint32(file, 2);
+    put_uint32(file, 12 + 8 + json.size() + 8 + binary_size);
+
+    put_uint32(file, json.size());
+    put_uint32(file, 0x4E4F534A);  // "JSON"
+    file.put(json);
+
+    put_uint32(file, binary_size);
+    put_uint32(file, 0x004E4942);  // "BIN"
+    file.write(m_binary.data(), m_binary.size());
+    const uint8_t zeros[4] = {0, 0, 0, 0};
+    file.write(zeros, binary_padding);
+    file.close();
+}
+
+size_t Slam_viewer::Writers::Glb_builder::add_indices_accessor(const void* indices, const size_t count,
+                                                               const size_t num_vertices)
+{
+    // the indices are uint32 values (Triangle and Edge are made of them)
+    if(num_vertices > 0xFFFF){
+        size_t view = add_buffer_view(indices, count * sizeof(uint32_t), 34963);
+        return add_accessor(view, 5125, count, "SCALAR", false);
+    }
+    std::vector<uint32_t> wide(count);
+    std::memcpy(wide.data(), indices, count * sizeof(uint32_t));
+    std::vector<uint16_t> narrow(count);
+    for(size_t i = 0; i < count; i++)
+        narrow[i] = static_cast<uint16_t>(wide[i]);
+    size_t view = add_buffer_view(narrow.data(), count * sizeof(uint16_t), 34963);
+    return add_accessor(view, 5123, count, "SCALAR", false);
+}
+
+size_t Slam_viewer::Writers::Glb_builder::add_buffer_view(const void* data, const size_t size,
+                                                          const int target, const size_t byte_stride)
+{
+    // accessors offsets have to be aligned to their component size
+    while(m_binary.size() % 4 != 0)
+        m_binary.push_back(0);
+
+    size_t offset = m_binary.size();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_binary.insert(m_binary.end(), bytes, bytes + size);
+
+    std::string view = "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset)
+            + ",\"byteLength\":" + std::to_string(size);
+    if(byte_stride != 0)
+        view += ",\"byteStride\":" + std::to_string(byte_stride);
+    if(target != 0)
+        view += ",\"target\":" + std::to_string(target);
+    m_buffer_views.push_back(view + "}");
+    return m_buffer_views.size() - 1;
+}
+
+size_t Slam_viewer::Writers::Glb_builder::add_accessor(const size_t buffer_view, const int component_type,
+                                                       const size_t count, const std::string& type,
+                                                       const bool normalized,
+                                                       const std::vector<double>& min,
+                                                       const std::vector<double>& max)
+{
+    std::string accessor = "{\"bufferView\":" + std::to_string(buffer_view)
+            + ",\"componentType\":" + std::to_string(component_type)
+            + ",\"count\":" + std::to_string(count)
+            + ",\"type\":\"" + type + "\"";
+    if(normalized)
+        accessor += ",\"normalized\":true";
+    if(!min.empty())
+        accessor += ",\"min\":" + json_array(min);
+    if(!max.empty())
+        accessor += ",\"max\":" + json_array(max);
+    m_accessors.push_back(accessor + "}");
+    return m_accessors.size() - 1;
+}
+
+void Slam_viewer::Writers::Glb_builder::use_extension(const std::string& name, const bool required)
+{
+    if(std::find(m_extensions_used.begin(), m_extensions_used.end(), name) == m_extensions_used.end())
+        m_extensions_used.push_back(name);
+    if(required && std::find(m_extensions_required.begin(), m_extensions_required.end(), name)
+            == m_extensions_required.end())
+        m_extensions_required.push_back(name);
+}
+
+std::string Slam_viewer::Writers::Glb_builder::json_number(const double value)
+{
+    char tmp[32];
+    int len = std::snprintf(tmp, sizeof(tmp), "%.17g", value);
+    return std::string(tmp, static_cast<size_t>(len));
+}
+
+std::string Slam_viewer::Writers::json_string(const std::string& str)
+{
+    std::string res = "\"";
+    for(char c: str){
+        if(c == '"' || c == '\\')
+            res += '\\';
+        if(static_cast<unsigned char>(c) >= 0x20)
+            res += c;
+    }
+    return res + "\"";
+}
+
+std::string Slam_viewer::Writers::Glb_builder::json_array(const std::vector<double>& values)
+{
+    std::string res = "[";
+    for(size_t i = 0; i < values.size(); i++)
+        res += (i == 0 ? "" : ",") + json_number(values[i]);
+    return res + "]";
+}
+
+
+void Slam_viewer::Writers::write_glb(const std::string& output_path,
+                                     const std::vector<Point>& points,
+                                     const std::vector<Triangle>& triangles,
+                                     const std::vector<Edge>& edges,
+                                     const bool quantize,
+                                     const std::vector<std::string>& comments)
+{
+    Glb_builder glb;
+    glb.set_comments(comments);
+    glb.add_mesh_node(points, triangles, edges, quantize);
+    glb.write(output_path);
+}
+
+void Slam_viewer::Writers::write_instanced_glb(const std::string& output_path,
+                                               const std::vector<Point>& points,
+                                               const std::vector<Triangle>& triangles,
+                                               const std::vector<Edge>& edges,
+                                               const bool quantize,
+                                               const std::vector<Point>& camera_points,
+                                               const std::vector<Triangle>& camera_triangles,
+                                               const std::vector<Camera_pose>& camera_poses,
+                                               const std::vector<Color>& camera_colors,
+                                               const std::vector<std::string>& comments)
+{
+    Glb_builder glb;
+    glb.set_comments(comments);
+    if(!points.empty())
+        glb.add_mesh_node(points, triangles, edges, quantize);
+    if(!camera_poses.empty())
+        glb.add_instanced_mesh_node(camera_points, camera_triangles, camera_poses, camera_colors);
+    glb.write(output_path);
+}
+
+namespace Slam_viewer {
+namespace Writers {
+namespace detail {
+
+// bits are packed starting from the least significant bit of each byte (deflate order)
+class Bit_writer {
+public:
+    void put(const uint32_t bits, const int count)
+    {
+        m_accumulator |= static_cast<uint64_t>(bits) << m_count;
+        m_count += count;
+        while(m_count >= 8){
+            m_bytes.push_back(static_cast<uint8_t>(m_accumulator));
+            m_accumulator >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    // Huffman codes are defined most significant bit first
+    void put_reversed(const uint32_t code, const int count)
+    {
+        uint32_t reversed = 0;
+        for(int i = 0; i < count; i++)
+            reversed |= ((code >> i) & 1u) << (count - 1 - i);
+        put(reversed, count);
+    }
+
+    std::vector<uint8_t>& finish()
+    {
+        if(m_count > 0)
+            put(0, 8 - m_count);
+        return m_bytes;
+    }
+
+private:
+    std::vector<uint8_t> m_bytes;
+    uint64_t m_accumulator {0};
+    int m_count {0};
+};
+
+inline void put_fixed_literal(Bit_writer& bits, const uint32_t symbol)
+{
+    if(symbol < 144)
+        bits.put_reversed(0x30 + symbol, 8);
+    else if(symbol < 256)
+        bits.put_reversed(0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+        bits.put_reversed(symbol - 256, 7);
+    else
+        bits.put_reversed(0xC0 + symbol - 280, 8);
+}
+
+inline void put_fixed_match(Bit_writer& bits, const uint32_t length, const uint32_t distance)
+{
+    static const uint32_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                             35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const int length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint32_t distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                               257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                               8193, 12289, 16385, 24577};
+    static const int distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                           7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    uint32_t l = 28;
+    while(length_base[l] > length)
+        l--;
+    put_fixed_literal(bits, 257 + l);
+    bits.put(length - length_base[l], length_extra[l]);
+
+    uint32_t d = 29;
+    while(distance_base[d] > distance)
+        d--;
+    bits.put_reversed(d, 5);
+    bits.put(distance - distance_base[d], distance_extra[d]);
+}
+
+inline uint32_t crc32(const uint8_t* data, const size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = [](){
+        std::array<uint32_t, 256> t;
+        for(uint32_t n = 0; n < 256; n++){
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+}
+}
+}
+
+void Slam_viewer::Writers::write_png(const std::string& output_path,
+                                     const std::vector<uint8_t>& rgb,
+                                     const size_t width,
+                                     const size_t height)
+{
+    if(width == 0 || height == 0 || rgb.size() != 3 * width * height){
+        throw std::runtime_error("In write_png: the image size does not match its data.");
+    }
+
+    // raw scanlines, each one starts with the filter type 0 (none)
+    const size_t stride = 3 * width + 1;
+    std::vector<uint8_t> raw(stride * height);
+    for(size_t y = 0; y < height; y++){
+        raw[y * stride] = 0;
+        std::memcpy(raw.data() + y * stride + 1, rgb.data() + y * 3 * width, 3 * width);
+    }
+
+    // zlib stream with a single fixed Huffman block, flat areas are
+    // encoded as copies of the previous pixel or of the pixel above
+    detail::Bit_writer bits;
+    bits.put(0x78, 8);
+    bits.put(0x01, 8);
+    bits.put(1, 1);  // last block
+    bits.put(1, 2);  // fixed Huffman codes
+    const size_t n = raw.size();
+    const size_t distances[2] = {3, stride};
+    size_t i = 0;
+    while(i < n){
+        size_t best_length = 0, best_distance = 0;
+        for(size_t d: distances){
+            if(d > i || d > 32768)
+                continue;
+            size_t length = 0;
+            while(length < 258 && i + length < n && raw[i + length] == raw[i + length - d])
+                length++;
+            if(length > best_length){
+                best_length = length;
+                best_distance = d;
+            }
+        }
+        if(best_length >= 3){
+            detail::put_fixed_match(bits, static_cast<uint32_t>(best_length),
+                                    static_cast<uint32_t>(best_distance));
+            i += best_length;
+        } else {
+            detail::put_fixed_literal(bits, raw[i]);
+            i++;
+        }
+    }
+    detail::put_fixed_literal(bits, 256);  // end of block
+    std::vector<uint8_t>& zlib = bits.finish();
+
+    uint32_t a = 1, b = 0;
+    for(uint8_t c: raw){
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    const uint32_t adler = (b << 16) | a;
+    for(int shift = 24; shift >= 0; shift -= 8)
+        zlib.push_back(static_cast<uint8_t>(adler >> shift));
+
+    Buffered_file file(output_path);
+    const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    file.write(signature, 8);
+    auto put_chunk = [&](const char* type, const std::vector<uint8_t>& data){
+        std::vector<uint8_t> chunk(type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        const uint32_t size = static_cast<uint32_t>(data.size());
+        const uint32_t crc = detail::crc32(chunk.data(), chunk.size());
+        const uint8_t size_bytes[4] = {static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16),
+                                       static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size)};
+        const uint8_t crc_bytes[4] = {static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16),
+                                      static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc)};
+        file.write(size_bytes, 4);
+        file.write(chunk.data(), chunk.size());
+        file.write(crc_bytes, 4);
+    };
+
+    std::vector<uint8_t> header(13, 0);
+    for(int k = 0; k < 4; k++){
+        header[k] = static_cast<uint8_t>(width >> (24 - 8 * k));
+        header[4 + k] = static_cast<uint8_t>(height >> (24 - 8 * k));
+    }
+    header[8] = 8;  // bit depth
+    header[9] = 2;  // RGB
+    put_chunk("IHDR", header);
+    put_chunk("IDAT", zlib);
+    put_chunk("IEND", std::vector<uint8_t>());
+    file.close();
+}
+
+void Slam_viewer::Writers::write_svg(const std::string& output_path,
+                                     const size_t width,
+                                     const size_t height,
+                                     const std::vector<Svg_polyline>& polylines,
+                                     const float stroke_width)
+{
+    char number[64];
+    auto put_number = [&](Buffered_file& file, const float value){
+        // a tenth of pixel is enough and keeps the file small
+        std::snprintf(number, sizeof(number), "%.1f", value);
+        file.put(std::string(number));
+    };
+    auto put_color = [&](Buffered_file& file, const Color c){
+        std::snprintf(number, sizeof(number), "#%02x%02x%02x", c.r, c.g, c.b);
+        file.put(std::string(number));
+    };
+
+    Buffered_file file(output_path);
+    file.put("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    file.put_uint(width);
+    file.put("\" height=\"");
+    file.put_uint(height);
+    file.put("\" viewBox=\"0 0 ");
+    file.put_uint(width);
+    file.put(' ');
+    file.put_uint(height);
+    file.put("\">\n<g fill=\"none\" stroke-width=\"");
+    put_number(file, stroke_width);
+    file.put("\" stroke-linecap=\"round\" stroke-linejoin=\"round\">\n");
+    for(auto& polyline: polylines){
+        if(polyline.points.size() < 2)
+            continue;
+        file.put("<polyline stroke=\"");
+        put_color(file, polyline.color);
+        file.put("\" points=\"");
+        for(size_t i = 0; i < polyline.points.size(); i++){
+            if(i > 0)
+                file.put(' ');
+            put_number(file, polyline.points[i][0]);
+            file.put(',');
+            put_number(file, polyline.points[i][1]);
+        }
+        file.put("\"/>\n");
+    }
+    file.put("</g>\n");
+
+    // discs are written last to stay on top of the lines
+    for(auto& polyline: polylines){
+        if(polyline.points.size() != 1)
+            continue;
+        file.put("<circle cx=\"");
+        put_number(file, polyline.points[0][0]);
+        file.put("\" cy=\"");
+        put_number(file, polyline.points[0][1]);
+        file.put("\" r=\"");
+        put_number(file, 2.5f * stroke_width);
+        file.put("\" fill=\"");
+        put_color(file, polyline.color);
+        file.put("\"/>\n");
+    }
+    file.put("</svg>\n");
+    file.close();
+}
+
+void Slam_viewer::Writers::write_mesh_file(const std::string& output_path,
+                                           const std::vector<Point>& points,
+                                           const std::vector<Triangle>& triangles,
+                                           const std::vector<Edge>& edges,
+                                           const bool quantize,
+                                           const std::vector<std::string>& comments,
+                                           const bool binary_ply)
+{
+    auto ends_with = [&](const std::string& extension){
+        return output_path.size() >= extension.size() &&
+                output_path.compare(output_path.size() - extension.size(), extension.size(), extension) == 0;
+    };
+    if(ends_with(".obj"))
+        write_obj(output_path, points, triangles, edges, comments);
+    else if(ends_with(".glb"))
+        write_glb(output_path, points, triangles, edges, quantize, comments);
+    else if(binary_ply)
+        write_binary_ply(output_path, points, triangles, edges, comments);
+    else
+        write_ply(output_path, points, triangles, edges, comments);
+}
+
+
+namespace Slam_viewer {
+namespace Writers {
+namespace detail {
+
+typedef std::array<int64_t, 3> Tile_cell;
+
+struct Tile_cell_hash {
+    size_t operator()(const Tile_cell& c) const
+    {
+        uint64_t h = static_cast<uint64_t>(c[0]) * 73856093ull;
+        h ^= static_cast<uint64_t>(c[1]) * 19349663ull;
+        h ^= static_cast<uint64_t>(c[2]) * 83492791ull;
+        return static_cast<size_t>(h);
+    }
+};
+
+struct Tile {
+    Tile_cell cell;
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> edges;
+    std::vector<uint32_t> points;  // points which are not used by any triangle or edge
+};
+
+}
+}
+}
+
+void Slam_viewer::Writers::write_tiles(const std::string& output_path,
+                                       const std::vector<Point>& points,
+                                       const std::vector<Triangle>& triangles,
+                                       const std::vector<Edge>& edges,
+                                       const float tile_size,
+                                       const bool quantize,
+                                       const std::vector<std::string>& comments,
+                                       const bool binary_ply)
+{
+    if(!(tile_size > 0)){
+        throw std::runtime_error("In write_tiles: the tile size should be positive.");
+    }
+
+    // split the output path into: directory / stem . extension
+    size_t slash = output_path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : output_path.substr(0, slash + 1);
+    std::string name = output_path.substr(directory.size());
+    size_t dot = name.find_last_of('.');
+    std::string extension = dot == std::string::npos ? ".ply" : name.substr(dot);
+    std::string stem = name.substr(0, dot);
+
+    // streaming pass: each element goes to the tile holding its center,
+    // tiles are created the first time one of their elements is met
+    std::unordered_map<detail::Tile_cell, size_t, detail::Tile_cell_hash> cell_to_tile;
+    std::vector<detail::Tile> tiles;
+    const double inv_size = 1.0 / static_cast<double>(tile_size);
+    auto tile_at = [&](const double x, const double y, const double z) -> detail::Tile& {
+        detail::Tile_cell cell = {{static_cast<int64_t>(std::floor(x * inv_size)),
+                                   static_cast<int64_t>(std::floor(y * inv_size)),
+                                   static_cast<int64_t>(std::floor(z * inv_size))}};
+        auto it = cell_to_tile.emplace(cell, tiles.size());
+        if(it.second){
+            tiles.push_back(detail::Tile());
+            tiles.back().cell = cell;
+        }
+        return tiles[it.first->second];
+    };
+
+    std::vector<uint8_t> used(points.size(), 0);
+    for(size_t i = 0; i < triangles.size(); i++){
+        const Point& a = points[triangles[i].a];
+        const Point& b = points[triangles[i].b];
+        const Point& c = points[triangles[i].c];
+        tile_at((static_cast<double>(a.x) + b.x + c.x) / 3,
+                (static_cast<double>(a.y) + b.y + c.y) / 3,
+                (static_cast<double>(a.z) + b.z + c.z) / 3).triangles.push_back(static_cast<uint32_t>(i));
+        used[triangles[i].a] = used[triangles[i].b] = used[triangles[i].c] = 1;
+    }
+    for(size_t i = 0; i < edges.size(); i++){
+        const Point& a = points[edges[i].a];
+        const Point& b = points[edges[i].b];
+        tile_at((static_cast<double>(a.x) + b.x) / 2,
+                (static_cast<double>(a.y) + b.y) / 2,
+                (static_cast<double>(a.z) + b.z) / 2).edges.push_back(static_cast<uint32_t>(i));
+        used[edges[i].a] = used[edges[i].b] = 1;
+    }
+    for(size_t i = 0; i < points.size(); i++)
+        if(!used[i])
+            tile_at(points[i].x, points[i].y, points[i].z).points.push_back(static_cast<uint32_t>(i));
+
+    // each tile gathers its own copy of the vertices it uses, so tiles are independent
+    std::vector<std::string> entries(tiles.size());
+    Parallel::parallel_tasks(tiles.size(), [&](const size_t t){
+        const detail::Tile& tile = tiles[t];
+        std::vector<Point> tile_points;
+        std::vector<Triangle> tile_triangles;
+        std::vector<Edge> tile_edges;
+        std::unordered_map<uint32_t, uint32_t> remap;
+        remap.reserve(3 * tile.triangles.size() + 2 * tile.edges.size() + tile.points.size());
+        auto local = [&](const uint32_t idx){
+            auto it = remap.emplace(idx, static_cast<uint32_t>(tile_points.size()));
+            if(it.second)
+                tile_points.push_back(points[idx]);
+            return it.first->second;
+        };
+        for(uint32_t i: tile.triangles){
+            Triangle tri;
+            tri.a = local(triangles[i].a);
+            tri.b = local(triangles[i].b);
+            tri.c = local(triangles[i].c);
+            tile_triangles.push_back(tri);
+        }
+        for(uint32_t i: tile.edges){
+            Edge e;
+            e.a = local(edges[i].a);
+            e.b = local(edges[i].b);
+            tile_edges.push_back(e);
+        }
+        for(uint32_t i: tile.points)
+            local(i);
+
+        std::string file_name = stem + "_tile_" + std::to_string(tile.cell[0]) + "_"
+                + std::to_string(tile.cell[1]) + "_" + std::to_string(tile.cell[2]) + extension;
+        write_mesh_file(directory + file_name, tile_points, tile_triangles, tile_edges, quantize, comments,
+                        binary_ply);
+
+        float min[3] = {tile_points[0].x, tile_points[0].y, tile_points[0].z};
+        float max[3] = {min[0], min[1], min[2]};
+        for(auto& p: tile_points){
+            const float v[3] = {p.x, p.y, p.z};
+            for(size_t j = 0; j < 3; j++){
+                min[j] = std::min(min[j], v[j]);
+                max[j] = std::max(max[j], v[j]);
+            }
+        }
+        auto json_floats = [](const float* v){
+            char tmp[96];
+            int len = std::snprintf(tmp, sizeof(tmp), "[%.9g,%.9g,%.9g]", v[0], v[1], v[2]);
+            return std::string(tmp, static_cast<size_t>(len));
+        };
+        entries[t] = "{\"file\":\"" + file_name + "\",\"cell\":["
+                + std::to_string(tile.cell[0]) + "," + std::to_string(tile.cell[1]) + ","
+                + std::to_string(tile.cell[2]) + "],\"min\":" + json_floats(min)
+                + ",\"max\":" + json_floats(max)
+                + ",\"vertices\":" + std::to_string(tile_points.size())
+                + ",\"faces\":" + std::to_string(tile_triangles.size())
+                + ",\"edges\":" + std::to_string(tile_edges.size()) + "}";
+    });
+
+    char tile_size_str[32];
+    std::snprintf(tile_size_str, sizeof(tile_size_str), "%.9g", tile_size);
+    Buffered_file manifest(directory + stem + "_tiles.json", 1 << 16);
+    manifest.put("{\n\"generator\":\"Slam Viewer\",\n");
+    if(!comments.empty()){
+        manifest.put("\"comments\":[");
+        for(size_t i = 0; i < comments.size(); i++)
+            manifest.put((i == 0 ? "" : ",") + json_string(comments[i]));
+        manifest.put("],\n");
+    }
+    manifest.put("\"tile_size\":" + std::string(tile_size_str) + ",\n\"tiles\":[\n");
+    for(size_t t = 0; t < entries.size(); t++)
+        manifest.put(entries[t] + (t + 1 < entries.size() ? ",\n" : "\n"));
+    manifest.put("]\n}\n");
+    manifest.close();
+}
@@ -1,7 +1,12 @@
 #include <iostream>
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
+#include <limits>
 
 #include "slam_viewer/viewer.hpp"
+#include "slam_viewer/evaluation.hpp"
 #include "cxxopts.hpp"
 
 
@@ -10,9 +15,15 @@ void cout_if(const bool verbose, const std::string msg);
 void cerr_if(const bool verbose, const std::string msg);
 
 cxxopts::ParseResult args_aparsing(int argc, const char *argv[]);
-void apply_angle_correction(const std::vector<float>& correction_angles,
-                            const bool verbose,
-                            std::vector<Slam_viewer::Camera_pose>& poses);
+Slam_viewer::Load_options load_options(const cxxopts::ParseResult& options, const bool verbose);
+void add_compared_trajectories(Slam_viewer::Viewer& viewer, const cxxopts::ParseResult& options,
+                               Slam_viewer::Load_options loading, const Slam_viewer::Trajectory& trajectory,
+                               const bool verbose);
+void evaluate_trajectory(const cxxopts::ParseResult& options, Slam_viewer::Load_options loading,
+                         const Slam_viewer::Trajectory& trajectory, std::vector<float>& pose_values,
+                         std::array<float, 2>& value_range, const bool verbose);
+void resample_trajectory(Slam_viewer::Trajectory& trajectory, const cxxopts::ParseResult& options,
+                         const bool verbose);
 std::string executable_name();
 
 
@@ -47,19 +58,120 @@ int main(int argc, const char *argv[]) {
     cout_if(verbose," ----- ----- ----- Camera trajectory viewer ----- ----- ----- ");
     cout_if(verbose,"");
 
-    std::vector<Slam_viewer::Camera_pose> poses =
-            Slam_viewer::Viewer::load_camera_poses_from_file(
-                options["input"].as<std::string>());
-    cout_if(verbose, "Successfully loaded poses from file: " + options["input"].as<std::string>());
+    Slam_viewer::Load_options loading = load_options(options, verbose);
+    const std::string input = options["input"].as<std::string>();
+    Slam_viewer::Trajectory trajectory;
+    Slam_viewer::Pose_graph graph;
+    if(input.size() >= 4 && input.compare(input.size() - 4, 4, ".g2o") == 0){
+        graph = Slam_viewer::Viewer::load_pose_graph_from_g2o_file(input, loading);
+        trajectory.poses.swap(graph.poses);
+        trajectory.origin = graph.origin;
+        cout_if(verbose, "Successfully loaded " + std::to_string(trajectory.poses.size()) + " vertices and "
+                + std::to_string(graph.edges.size()) + " edges from file: " + input);
+    } else {
+        trajectory = Slam_viewer::Viewer::load_trajectory_from_file(input, loading);
+        cout_if(verbose, "Successfully loaded poses from file: " + input);
+        resample_trajectory(trajectory, options, verbose);
+    }
+    std::vector<Slam_viewer::Camera_pose>& poses = trajectory.poses;
 
-    apply_angle_correction(options["angle"].as<std::vector<float>>(), verbose, poses);
+    // per pose values of --error-colors and the range of their colors
+    std::vector<float> pose_values;
+    std::array<float, 2> value_range {{0, 0}};
+    if(options.count("ground-truth"))
+        evaluate_trajectory(options, loading, trajectory, pose_values, value_range, verbose);
 
     Slam_viewer::Viewer viewer;
     viewer.set_verbose(verbose);
     viewer.set_cameras_poses(poses);
+    viewer.set_graph_edges(graph.edges);
+
+    // with timestamps, the gap between a camera and its revisited camera is a duration, by default the
+    // pose count gap times the median timestamp step, so it does not depend on the unit of the timestamps
+    if(options["revisit-radius"].as<float>() > 0 && !trajectory.timestamps.empty()){
+        const std::vector<double>& t = trajectory.timestamps;
+        if(std::is_sorted(t.begin(), t.end())){
+            double time_gap = 0;
+            if(options.count("revisit-time-gap")){
+                time_gap = options["revisit-time-gap"].as<double>();
+            } else if(t.size() > 1){
+                std::vector<double> steps(t.size() - 1);
+                for(size_t k = 0; k + 1 < t.size(); k++)
+                    steps[k] = t[k + 1] - t[k];
+                std::nth_element(steps.begin(), steps.begin() + steps.size() / 2, steps.end());
+                time_gap = options["revisit-gap"].as<size_t>() * steps[steps.size() / 2];
+            }
+            cout_if(verbose, "Revisit time gap: " + Slam_viewer::Marithmetic::to_string_with_precision(time_gap, 4)
+                    + (options.count("revisit-time-gap") ? "" : " (revisit gap times the median timestamp step)"));
+            viewer.set_revisit_timestamps(t, time_gap);
+        } else {
+            cerr_if(verbose, "Warning: The timestamps are not sorted, the revisit gap is counted in poses");
+        }
+    }
+
+    // covariance ellipsoids from the given file or from the information matrices of the pose graph
+    float sigma = options["ellipsoids"].as<float>();
+    if(options.count("covariances")){
+        std::string covariances_path = options["covariances"].as<std::string>();
+        viewer.set_covariances(Slam_viewer::Viewer::load_covariances_from_file(covariances_path));
+        cout_if(verbose, "Successfully loaded covariances from file: " + covariances_path);
+        if(sigma <= 0)
+            sigma = 1;
+    } else if(sigma > 0){
+        viewer.set_covariances(graph.covariances);
+        // the covariances come from the odometry edges with a full information matrix
+        size_t num_covariances = 0;
+        for(const Slam_viewer::Covariance& c: graph.covariances)
+            if(c.xx != 0 || c.xy != 0 || c.xz != 0 || c.yy != 0 || c.yz != 0 || c.zz != 0)
+                num_covariances++;
+        if(num_covariances == 0){
+            cerr_if(verbose, "Warning: No ellipsoid is shown, the input has no odometry edge with an invertible "
+                             "position information block (the covariances come from the .g2o odometry edges)");
+        } else {
+            cout_if(verbose, "Covariances of " + std::to_string(num_covariances) + " of the "
+                    + std::to_string(graph.covariances.size()) + " poses come from their odometry edge");
+        }
+    }
+    viewer.set_covariance_sigma(sigma);
+    if(loading.shift_origin)
+        viewer.set_origin(trajectory.origin);
+
+    std::vector<float> angles = options["angle"].as<std::vector<float>>();
+    if(angles.size() == 3){
+        viewer.set_correction_angles(angles.at(0), angles.at(1), angles.at(2));
+    } else {
+        cerr_if(verbose, "Warning: Wrong format of angle, use example: --angle=<rx>,<ry>,<rz>");
+    }
+
     viewer.set_resize_factor(options["resize"].as<float>());
     viewer.set_cameras_downsample_factor(options["subsample"].as<int>());
     viewer.set_links_downsample_factor(options["links"].as<int>());
+    viewer.set_gltf_quantization(options.count("quantize"));
+    viewer.set_gltf_instancing(options.count("instancing"));
+    viewer.set_binary_ply(options.count("binary"));
+    viewer.set_points_and_edges_mode(options.count("points"));
+    viewer.set_tile_size(options["tile"].as<float>());
+    viewer.set_mesh_optimization(options.count("optimize"));
+    viewer.set_revisit_detection(options["revisit-radius"].as<float>(), options["revisit-gap"].as<size_t>());
+
+    std::vector<int> image_size = options["size"].as<std::vector<int>>();
+    if(image_size.size() == 2 && image_size[0] > 0 && image_size[1] > 0){
+        viewer.set_render_size(image_size[0], image_size[1]);
+    } else {
+        cerr_if(verbose, "Warning: Wrong image size, use example: --size=<width>,<height>");
+    }
+
+    viewer.set_svg_plane(options["plane"].as<std::string>());
+    viewer.set_svg_tolerance(options["tolerance"].as<float>());
+
+    if(options.count("view")){
+        std::vector<float> view = options["view"].as<std::vector<float>>();
+        if(view.size() == 6){
+            viewer.set_render_view({view[0], view[1], view[2]}, {view[3], view[4], view[5]});
+        } else {
+            cerr_if(verbose, "Warning: Wrong view, use example: --view=<ex>,<ey>,<ez>,<tx>,<ty>,<tz>");
+        }
+    }
 
     std::vector<int> f_color = options["first"].as<std::vector<int>>();
     if(f_color.size() == 3){
@@ -75,7 +187,38 @@ int main(int argc, const char *argv[]) {
         cerr_if(verbose, "Warning: Wrong last camera color, use example: --last=<r>,<g>,<b>");
     }
 
-    viewer.write_cameras_trajectory_to_ply_file(options["output"].as<std::string>());
+    if(!pose_values.empty()){
+        // heat map from blue (no error) to red
+        viewer.set_colors_palette({{0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}});
+        viewer.set_cameras_values(pose_values, value_range[1], value_range[0]);
+    }
+
+    if(options.count("compare"))
+        add_compared_trajectories(viewer, options, loading, trajectory, verbose);
+
+    if(options.count("map")){
+        // the map shares the origin of the trajectory
+        Slam_viewer::Load_options map_loading = loading;
+        map_loading.automatic_origin = false;
+        map_loading.origin = trajectory.origin;
+        const std::string map_path = options["map"].as<std::string>();
+        Slam_viewer::Point_cloud map = Slam_viewer::Viewer::load_point_cloud_from_file(
+                    map_path, options["map-leaf"].as<double>(), map_loading);
+        viewer.set_map_points(map.points);
+        cout_if(verbose, "Successfully loaded " + std::to_string(map.num_read_points) + " map points, "
+                + std::to_string(map.points.size()) + " kept, from file: " + map_path);
+    }
+
+    std::vector<int> odometry_color = options["odometry-color"].as<std::vector<int>>();
+    std::vector<int> loop_color = options["loop-color"].as<std::vector<int>>();
+    if(odometry_color.size() == 3 && loop_color.size() == 3){
+        viewer.set_odometry_color(odometry_color.at(0), odometry_color.at(1), odometry_color.at(2));
+        viewer.set_loop_closure_color(loop_color.at(0), loop_color.at(1), loop_color.at(2));
+    } else {
+        cerr_if(verbose, "Warning: Wrong graph edges color, use example: --loop-color=<r>,<g>,<b>");
+    }
+
+    viewer.write_cameras_trajectory_to_file(options["output"].as<std::string>());
 
     cout_if(verbose,"");
     cout_if(verbose," ----- ----- ----- Viewer terminated ----- ----- ----- ");
@@ -93,8 +236,10 @@ cxxopts::ParseResult args_aparsing(int argc, const char *argv[])
                              "This program shows the trajectory of camera as .ply file");
     options.allow_unrecognised_options()
             .add_options()
-            ("i,input", "Input file path (required)", cxxopts::value<std::string>())
-            ("o,output", "Output file path", cxxopts::value<std::string>()
+            ("i,input", "Input file path (required), .g2o files are read as pose graphs", cxxopts::value<std::string>())
+            ("o,output", "Output file path, the format is chosen by the extension: .ply, .obj, .glb "
+                         "or .png (rendered image), .svg (2D path)",
+             cxxopts::value<std::string>()
              ->default_value(output_default))
             ("s,subsample", "Subsampling the number of cameras <int>: "
                             "0 means cameras will not be shown.",
@@ -110,6 +255,103 @@ cxxopts::ParseResult args_aparsing(int argc, const char *argv[])
              cxxopts::value<std::vector<int>>()->default_value("255,0,0"))
             ("l,last", "Last camera color [r, g, b]",
              cxxopts::value<std::vector<int>>()->default_value("0,0,255"))
+            ("q,quantize", "Store .glb positions as int16 inside the bounding box (KHR_mesh_quantization)")
+            ("p,points", "Show the trajectory as one vertex per camera center linked by edges, "
+                         "cameras cones are still shown according to --subsample")
+            ("t,tile", "Split the output in cubic tiles of this size <float> saved in separate files "
+                       "listed in a .json manifest: 0 means no tiling",
+             cxxopts::value<float>()->default_value("0"))
+            ("binary", "Write binary .ply files, with 16 bits indices up to 65536 vertices (e.g. tiles)")
+            ("optimize", "Order the cameras and links triangles for the GPU vertex cache")
+            ("instancing", "Write .glb cameras as instances of one template (EXT_mesh_gpu_instancing)")
+            ("size", "Size of .png and .svg images [width, height]",
+             cxxopts::value<std::vector<int>>()->default_value("1024,768"))
+            ("view", "Camera of .png images [eye x, y, z, target x, y, z], "
+                     "by default the whole trajectory is shown",
+             cxxopts::value<std::vector<float>>())
+            ("plane", "Plane of .svg paths: xy, xz or yz",
+             cxxopts::value<std::string>()->default_value("xz"))
+            ("tolerance", "Simplification tolerance of .svg paths in pixels <float>",
+             cxxopts::value<float>()->default_value("0.5"))
+            ("convention", "Camera frame convention of the input poses: opencv, opengl, ros or ros_optical",
+             cxxopts::value<std::string>()->default_value("opencv"))
+            ("invert", "The input poses are world-to-camera, they are inverted while loading")
+            ("world-rotation", "Rotation applied to the world frame according to x->y->z axis in degrees",
+             cxxopts::value<std::vector<float>>()->default_value("0,0,0"))
+            ("world-translation", "Translation applied to the world frame [x, y, z] after the rotation",
+             cxxopts::value<std::vector<float>>()->default_value("0,0,0"))
+            ("world-scale", "Scale applied to the positions <float> before the translation",
+             cxxopts::value<float>()->default_value("1"))
+            ("shift-origin", "Parse the positions in double precision and subtract the first one from all "
+                             "positions, the origin is written in the output file header")
+            ("origin", "Same as --shift-origin with the given origin [x, y, z]",
+             cxxopts::value<std::vector<double>>())
+            ("covariances", "Position covariances file, one line per pose [... xx xy xz yy yz zz], "
+                            "an ellipsoid is drawn at each shown camera",
+             cxxopts::value<std::string>())
+            ("ellipsoids", "Size of the covariance ellipsoids in standard deviations <float>, the covariances "
+                           "of .g2o pose graphs come from their odometry edges: 0 means no ellipsoids "
+                           "(1 if --covariances is given)",
+             cxxopts::value<float>()->default_value("0"))
+            ("odometry-color", "Color of the odometry edges of .g2o pose graphs [r, g, b]",
+             cxxopts::value<std::vector<int>>()->default_value("150,150,150"))
+            ("loop-color", "Color of the loop closure edges of .g2o pose graphs [r, g, b]",
+             cxxopts::value<std::vector<int>>()->default_value("255,140,0"))
+            ("revisit-radius", "Link each camera to the closest earlier camera within this distance <float>, "
+                               "where a loop closure is expected: 0 means no revisit detection",
+             cxxopts::value<float>()->default_value("0"))
+            ("revisit-time-gap", "Minimal time between a camera and its revisited camera <float>, in the unit "
+                                 "of the timestamps, used when the poses have timestamps (default: "
+                                 "--revisit-gap times the median timestamp step)",
+             cxxopts::value<double>())
+            ("revisit-gap", "Minimal number of poses between a camera and its revisited camera <int>, "
+                            "used when the poses have no timestamps and for the default --revisit-time-gap",
+             cxxopts::value<size_t>()->default_value("100"))
+            ("compare", "Other trajectory files shown in the same output, each one with its own colors "
+                        "[file1, file2, ...]",
+             cxxopts::value<std::vector<std::string>>())
+            ("resample-time", "Resample the poses at this period <float>, in the unit of the timestamps "
+                              "(the number before the position on each line): 0 means no resampling",
+             cxxopts::value<double>()->default_value("0"))
+            ("resample-distance", "Resample the poses at this distance along the path <float>: "
+                                  "0 means no resampling",
+             cxxopts::value<double>()->default_value("0"))
+            ("ground-truth", "Ground truth trajectory file, the absolute trajectory error and the relative "
+                             "pose errors of the input poses are printed. The poses are matched by timestamp "
+                             "if both files have timestamps, by index otherwise",
+             cxxopts::value<std::string>())
+            ("max-time-difference", "Maximal timestamp difference of the poses matched with the ground truth "
+                                    "<float>",
+             cxxopts::value<double>()->default_value("0.02"))
+            ("interpolate-truth", "Match the poses with the ground truth interpolated at their timestamps")
+            ("align", "Alignment of the input poses on the ground truth: se3, sim3 (with scale) or none",
+             cxxopts::value<std::string>()->default_value("se3"))
+            ("rpe-deltas", "Pose index deltas of the relative pose errors [d1, d2, ...]",
+             cxxopts::value<std::vector<size_t>>()->default_value("1"))
+            ("kitti", "The input, ground truth and compared poses are KITTI odometry files, one 3x4 matrix "
+                      "per line [r00 r01 r02 x r10 r11 r12 y r20 r21 r22 z], the KITTI drift is printed "
+                      "with the ground truth errors")
+            ("drift-lengths", "Segment lengths of the KITTI drift printed with the ground truth errors "
+                              "[l1, l2, ...], by default with --kitti only",
+             cxxopts::value<std::vector<double>>()->default_value("100,200,300,400,500,600,700,800"))
+            ("drift-step", "Pose index step between the starts of the KITTI drift segments <int>",
+             cxxopts::value<size_t>()->default_value("10"))
+            ("scale-window", "Number of poses of the sliding windows aligned with a scale on the ground truth "
+                             "<int>, the statistics of the scales along the trajectory are printed: 0 means "
+                             "no windows",
+             cxxopts::value<size_t>()->default_value("0"))
+            ("error-colors", "Color the cameras and links by their aligned error against the ground truth "
+                             "instead of by index: translation or rotation, from blue (no error) to red, or "
+                             "scale, the scale of their window from blue (smallest) to red (largest). "
+                             "The poses without ground truth are grey",
+             cxxopts::value<std::string>())
+            ("error-max", "Error shown in red by --error-colors <float>: 0 means the largest error",
+             cxxopts::value<float>()->default_value("0"))
+            ("map", "Map points file merged in the output, text lines [x y z] or [x y z r g b] or a .ply file",
+             cxxopts::value<std::string>())
+            ("map-leaf", "Voxel size of the map downsampling <float>, one point is kept per voxel: "
+                         "0 means all map points are kept",
+             cxxopts::value<double>()->default_value("0"))
             ("v,verbose", "Show verbose messages")
             ("h,help", "Print this help")
 
@@ -127,34 +369,240 @@ cxxopts::ParseResult args_aparsing(int argc, const char *argv[])
     return options_result;
 }
 
-void apply_angle_correction(const std::vector<float>& correction_angles,
-                            const bool verbose,
-                            std::vector<Slam_viewer::Camera_pose>& poses)
+Slam_viewer::Load_options load_options(const cxxopts::ParseResult& options, const bool verbose)
 {
-    namespace sl = Slam_viewer::linalg;
-    if(correction_angles.size() != 3){
-        cerr_if(verbose, "Warning: Wrong format of angle, use example: --angle=<rx>,<ry>,<rz>");
-        return;
+    // the inversion comes first, then the camera frame and the world frame changes
+    Slam_viewer::Load_options load_options;
+    if(options.count("origin")){
+        std::vector<double> origin = options["origin"].as<std::vector<double>>();
+        load_options.shift_origin = true;
+        if(origin.size() == 3){
+            load_options.automatic_origin = false;
+            load_options.origin = {{origin[0], origin[1], origin[2]}};
+        } else {
+            cerr_if(verbose, "Warning: Wrong origin, the first position is used, use example: --origin=<x>,<y>,<z>");
+        }
+    } else if(options.count("shift-origin")){
+        load_options.shift_origin = true;
     }
+    load_options.kitti_format = options.count("kitti");
 
+    if(options.count("invert")){
+        Slam_viewer::Pose_transform inversion;
+        inversion.invert = true;
+        load_options.transforms.push_back(inversion);
+    }
 
-    std::vector<float> rot = correction_angles;
-    if(fabs(rot[0]) + fabs(rot[1]) + fabs(rot[2]) <= (10 * std::numeric_limits<float>::epsilon()))
-        return;
+    std::string convention = options["convention"].as<std::string>();
+    if(convention != "opencv" && convention != "ros_optical"){
+        cout_if(verbose, "Converting the camera frames from the " + convention + " convention");
+        load_options.transforms.push_back(Slam_viewer::Marithmetic::frame_convention(convention));
+    }
+
+    std::vector<float> rotation = options["world-rotation"].as<std::vector<float>>();
+    std::vector<float> translation = options["world-translation"].as<std::vector<float>>();
+    if(rotation.size() != 3 || translation.size() != 3){
+        cerr_if(verbose, "Warning: Wrong world transform, use example: "
+                         "--world-rotation=<rx>,<ry>,<rz> --world-translation=<x>,<y>,<z>");
+        return load_options;
+    }
+    Slam_viewer::Pose_transform world;
+    world.rotation = Slam_viewer::Marithmetic::from_euler_in_degrees(rotation[0], rotation[1], rotation[2]);
+    world.translation = {translation[0], translation[1], translation[2]};
+    world.scale = options["world-scale"].as<float>();
+    bool identity = rotation == std::vector<float>{0, 0, 0} && translation == std::vector<float>{0, 0, 0}
+            && world.scale == 1;
+    if(!identity){
+        cout_if(verbose, "Applying the world transform while loading");
+        load_options.transforms.push_back(world);
+    }
+    return load_options;
+}
+
+void add_compared_trajectories(Slam_viewer::Viewer& viewer, const cxxopts::ParseResult& options,
+                               Slam_viewer::Load_options loading, const Slam_viewer::Trajectory& trajectory,
+                               const bool verbose)
+{
+    // first and last colors of the compared trajectories, the input one uses --first and --last
+    const std::vector<std::array<Slam_viewer::Color, 2>> colors = {
+        {{{0, 160, 0}, {230, 200, 0}}},
+        {{{200, 0, 200}, {0, 200, 200}}},
+        {{{255, 128, 0}, {100, 0, 160}}},
+        {{{60, 60, 60}, {190, 190, 190}}},
+        {{{120, 60, 0}, {255, 150, 150}}}
+    };
+
+    // all trajectories share the origin of the input one
+    loading.automatic_origin = false;
+    loading.origin = trajectory.origin;
+
+    std::vector<std::string> paths = options["compare"].as<std::vector<std::string>>();
+    for(size_t k = 0; k < paths.size(); k++){
+        Slam_viewer::Pose_set pose_set;
+        pose_set.name = paths[k].substr(paths[k].find_last_of("/\\") + 1);
+        pose_set.name = pose_set.name.substr(0, pose_set.name.find_last_of('.'));
+        Slam_viewer::Trajectory compared = Slam_viewer::Viewer::load_trajectory_from_file(paths[k], loading);
+        resample_trajectory(compared, options, verbose);
+        pose_set.poses.swap(compared.poses);
+        pose_set.first_color = colors[k % colors.size()][0];
+        pose_set.last_color = colors[k % colors.size()][1];
+        pose_set.resize = options["resize"].as<float>();
+        pose_set.downsample_cameras = options["subsample"].as<int>();
+        pose_set.downsample_links = options["links"].as<int>();
+        viewer.add_pose_set(pose_set);
+        cout_if(verbose, "Successfully loaded poses to compare from file: " + paths[k]);
+    }
+}
 
-    cout_if(verbose, "Applying angle to all poses: [rx=" + std::to_string(rot[0])
-            + ", ry=" + std::to_string(rot[1]) + ", rz=" + std::to_string(rot[2]) + "]");
+void evaluate_trajectory(const cxxopts::ParseResult& options, Slam_viewer::Load_options loading,
+                         const Slam_viewer::Trajectory& trajectory, std::vector<float>& pose_values,
+                         std::array<float, 2>& value_range, const bool verbose)
+{
+    // the ground truth shares the origin of the input poses
+    loading.automatic_origin = false;
+    loading.origin = trajectory.origin;
+    const std::string path = options["ground-truth"].as<std::string>();
+    Slam_viewer::Trajectory ground_truth = Slam_viewer::Viewer::load_trajectory_from_file(path, loading);
+    cout_if(verbose, "Successfully loaded ground truth poses from file: " + path);
+
+    // the poses are matched by timestamp if both files have some, by index otherwise
+    std::vector<Slam_viewer::Camera_pose> estimate = trajectory.poses;
+    std::vector<Slam_viewer::Camera_pose> truth = ground_truth.poses;
+    std::vector<Slam_viewer::Evaluation::Association> associations;
+    if(!trajectory.timestamps.empty() && !ground_truth.timestamps.empty()){
+        associations = Slam_viewer::Evaluation::associate(
+                    trajectory.timestamps, ground_truth.timestamps, options["max-time-difference"].as<double>(),
+                    options.count("interpolate-truth"));
+        Slam_viewer::Evaluation::matched_poses(trajectory.poses, ground_truth.poses, associations, estimate, truth);
+        cout_if(verbose, "Matched " + std::to_string(associations.size()) + " of the "
+                + std::to_string(trajectory.poses.size()) + " poses with the ground truth by timestamp");
+    }
 
+    const std::string mode = options["align"].as<std::string>();
+    Slam_viewer::Pose_transform alignment;
+    if(mode == "se3" || mode == "sim3"){
+        alignment = Slam_viewer::Evaluation::align(estimate, truth, mode == "sim3");
+    } else if(mode != "none"){
+        cerr_if(verbose, "Warning: Wrong alignment '" + mode + "', the poses are not aligned, "
+                         "use example: --align=sim3");
+    }
 
-    Slam_viewer::Quaternion correction;
-    correction.from_euler_in_degrees(rot[0], rot[1], rot[2]);
+    auto to_string = [](const Slam_viewer::Evaluation::Error_statistics& stats, const std::string& unit){
+        using Slam_viewer::Marithmetic::to_string_with_precision;
+        return "rmse " + to_string_with_precision(stats.rmse) + unit
+                + ", mean " + to_string_with_precision(stats.mean) + unit
+                + ", median " + to_string_with_precision(stats.median) + unit
+                + ", max " + to_string_with_precision(stats.max) + unit
+                + " (" + std::to_string(stats.count) + ")";
+    };
+    Slam_viewer::Evaluation::Error_statistics absolute = Slam_viewer::Evaluation::statistics(
+                Slam_viewer::Evaluation::absolute_errors(estimate, truth, alignment));
+    std::cout << "ATE (" << mode << " alignment, scale " << alignment.scale << "): "
+              << to_string(absolute, "") << std::endl;
+    for(size_t delta: options["rpe-deltas"].as<std::vector<size_t>>()){
+        if(delta == 0){
+            cerr_if(verbose, "Warning: The relative pose error delta 0 is skipped");
+            continue;
+        }
+        Slam_viewer::Evaluation::Relative_error relative = Slam_viewer::Evaluation::relative_error(
+                    estimate, truth, delta, alignment.scale);
+        std::cout << "RPE (delta " << delta << ") translation: " << to_string(relative.translation, "") << std::endl;
+        std::cout << "RPE (delta " << delta << ") rotation: " << to_string(relative.rotation_degrees, " deg")
+                  << std::endl;
+    }
 
-//    Slam_viewer::Marithmetic::printv(correction, 4, "correction_quaternion");
+    if(options.count("kitti") || options.count("drift-lengths")){
+        // the devkit prints the translation errors in percent
+        using Slam_viewer::Marithmetic::to_string_with_precision;
+        const Slam_viewer::Evaluation::Drift drift = Slam_viewer::Evaluation::segment_drift(
+                    estimate, truth, options["drift-lengths"].as<std::vector<double>>(),
+                    std::max<size_t>(1, options["drift-step"].as<size_t>()), alignment.scale);
+        for(const Slam_viewer::Evaluation::Segment_drift& segment: drift.segments){
+            std::cout << "Drift (length " << segment.length << ") translation: "
+                      << to_string_with_precision(segment.translation * 100) << " %, rotation: "
+                      << to_string_with_precision(segment.rotation_degrees) << " deg/m ("
+                      << segment.count << ")" << std::endl;
+        }
+        std::cout << "Drift translation: " << to_string_with_precision(drift.total.translation * 100)
+                  << " %, rotation: " << to_string_with_precision(drift.total.rotation_degrees) << " deg/m ("
+                  << drift.total.count << ")" << std::endl;
+    }
 
-    for(auto& pose: poses){
-        pose.q = pose.q * correction;
+    const size_t window = options["scale-window"].as<size_t>();
+    std::vector<double> scales;
+    if(window > 0){
+        scales = Slam_viewer::Evaluation::window_scales(estimate, truth, std::min(window, estimate.size()));
+        std::vector<double> finite_scales;
+        for(const double scale: scales){
+            if(std::isfinite(scale))
+                finite_scales.push_back(scale);
+        }
+        std::sort(finite_scales.begin(), finite_scales.end());
+        if(!finite_scales.empty()){
+            using Slam_viewer::Marithmetic::to_string_with_precision;
+            std::cout << "Window scale (" << window << " poses): min " << to_string_with_precision(finite_scales.front())
+                      << ", median " << to_string_with_precision(finite_scales[finite_scales.size() / 2])
+                      << ", max " << to_string_with_precision(finite_scales.back())
+                      << " (" << finite_scales.size() << ")" << std::endl;
+            value_range = {{static_cast<float>(finite_scales.front()), static_cast<float>(finite_scales.back())}};
+        }
     }
 
+    if(!options.count("error-colors"))
+        return;
+    const std::string colors = options["error-colors"].as<std::string>();
+    std::vector<float> values;
+    if(colors == "translation" || colors == "rotation"){
+        std::vector<float> translation_errors, rotation_errors;
+        Slam_viewer::Evaluation::pose_errors(estimate, truth, alignment, translation_errors, rotation_errors);
+        values.swap(colors == "translation" ? translation_errors : rotation_errors);
+        value_range = {{0, options["error-max"].as<float>()}};
+    } else if(colors == "scale" && !scales.empty()){
+        values.assign(scales.begin(), scales.end());
+    } else if(colors == "scale"){
+        cerr_if(verbose, "Warning: The scale colors need windows, the poses are colored by index, "
+                         "use example: --scale-window=100");
+        return;
+    } else {
+        cerr_if(verbose, "Warning: Wrong error colors '" + colors + "', the poses are colored by index, "
+                         "use example: --error-colors=translation");
+        return;
+    }
+    if(associations.empty()){
+        pose_values.swap(values);
+        return;
+    }
+    // back to the order of the input poses, the poses without ground truth have no value
+    pose_values.assign(trajectory.poses.size(), std::numeric_limits<float>::quiet_NaN());
+    for(size_t k = 0; k < associations.size(); k++)
+        pose_values[associations[k].estimate] = values[k];
+}
+
+void resample_trajectory(Slam_viewer::Trajectory& trajectory, const cxxopts::ParseResult& options,
+                         const bool verbose)
+{
+    const double period = options["resample-time"].as<double>();
+    const double distance = options["resample-distance"].as<double>();
+    const size_t num_poses = trajectory.poses.size();
+    if(period > 0){
+        if(trajectory.timestamps.empty()){
+            cerr_if(verbose, "Warning: The poses have no timestamps, they are not resampled in time");
+            return;
+        }
+        trajectory.poses = Slam_viewer::Marithmetic::resample_poses(trajectory.poses, trajectory.timestamps, period);
+        const double first = trajectory.timestamps.front();
+        trajectory.timestamps.resize(trajectory.poses.size());
+        for(size_t k = 0; k < trajectory.timestamps.size(); k++)
+            trajectory.timestamps[k] = first + k * period;
+    } else if(distance > 0){
+        trajectory.poses = Slam_viewer::Marithmetic::resample_poses(
+                    trajectory.poses, Slam_viewer::Marithmetic::arc_lengths(trajectory.poses), distance);
+        trajectory.timestamps.clear();
+    } else {
+        return;
+    }
+    cout_if(verbose, "Resampled " + std::to_string(num_poses) + " poses to "
+            + std::to_string(trajectory.poses.size()) + " poses");
 }
 
 std::string executable_name()